@@ -0,0 +1,191 @@
+/**
+ * Author: Matej Postolka <matej@postolka.net>
+ * License: BSD 3-clause
+ */
+
+#include <stdexcept>
+#include <sstream>
+#include <cstdlib>
+#include <cmath>
+#include <limits>
+#include <iostream>
+
+#include "AlertEngine.h"
+#include "Server.h"
+
+EHW::AlertEngine::AlertEngine(const char *rules_path, const char *alert_path) : m_output{&std::cerr}
+{
+    std::ifstream rules(rules_path);
+    if (!rules) {
+        throw std::runtime_error("cannot open rules file");
+    }
+
+    std::string line;
+    size_t line_number = 0;
+    while (std::getline(rules, line)) {
+        line_number++;
+
+        // Skip empty lines and comments
+        auto first = line.find_first_not_of(" \t\r");
+        if (first == std::string::npos || line[first] == '#') {
+            continue;
+        }
+
+        if (!compile(line)) {
+            throw std::runtime_error("malformed rule on line " + std::to_string(line_number));
+        }
+    }
+
+    if (alert_path) {
+        m_file.open(alert_path, std::ios::app);
+        if (!m_file) {
+            throw std::runtime_error("cannot open alert file for writing");
+        }
+        m_output = &m_file;
+    }
+}
+
+void EHW::AlertEngine::evaluate(const DataPack &pack)
+{
+    auto type = static_cast<size_t>(pack.get_type());
+    if (type >= m_tables.size() || m_tables[type].predicates.empty()) {
+        return;
+    }
+    auto &table = m_tables[type];
+    auto predicate_count = table.predicates.size();
+
+    // Assign slot to device on its first reading, previous value is unknown
+    auto it = table.devices.find(pack.get_id());
+    if (it == table.devices.end()) {
+        it = table.devices.emplace(pack.get_id(), static_cast<uint32_t>(table.last_values.size())).first;
+        table.last_values.push_back(std::numeric_limits<double>::quiet_NaN());
+        table.last_times.push_back(0);
+        table.streaks.resize(table.streaks.size() + predicate_count, 0);
+    }
+    auto slot = it->second;
+
+    // Non-numeric value is NaN, which fails every comparison
+    auto data = pack.get_data();
+    char *end;
+    auto value = std::strtod(data.c_str(), &end);
+    if (data.empty() || *end != '\0') {
+        value = std::numeric_limits<double>::quiet_NaN();
+    }
+
+    // Readings received in one event loop iteration share receive time and the clock may step back, rate of
+    // such reading is unknown
+    auto time = pack.get_receive_time();
+    auto delta = value - table.last_values[slot];
+    auto rate = std::numeric_limits<double>::quiet_NaN();
+    if (time > table.last_times[slot]) {
+        rate = delta / (static_cast<double>(time - table.last_times[slot]) / 1e9);
+    }
+    double subjects[SUBJECT_COUNT] = {value, delta, rate};
+    table.last_values[slot] = value;
+    table.last_times[slot] = time;
+
+    auto streaks = table.streaks.data() + slot * predicate_count;
+    for (size_t i = 0; i < predicate_count; i++) {
+        const auto &predicate = table.predicates[i];
+        auto subject = subjects[static_cast<size_t>(predicate.subject)];
+        auto holds = static_cast<uint32_t>((subject >= predicate.lower) & (subject <= predicate.upper));
+
+        // Run of satisfying readings is reset by first reading not satisfying the predicate
+        streaks[i] = (streaks[i] + 1) * holds;
+        if (streaks[i] == predicate.count) {
+            raise(pack, m_rules[predicate.rule]);
+        }
+    }
+}
+
+void EHW::AlertEngine::report(std::ostream &s) const
+{
+    for (const auto &rule : m_rules) {
+        s << "Rule: " << rule.name << "\talerts raised: " << rule.alerts << std::endl;
+    }
+}
+
+bool EHW::AlertEngine::compile(const std::string &line)
+{
+    std::istringstream ss(line);
+    std::string name, type_name, subject_name, op, threshold_str, for_keyword, extra;
+    // Parsed signed, so that negative count is rejected instead of wrapping around
+    int64_t count = 1;
+
+    if (!(ss >> name >> type_name >> subject_name >> op >> threshold_str)) {
+        return false;
+    }
+    if (ss >> for_keyword) {
+        if (for_keyword != "for" || !(ss >> count) || count <= 0 || count > UINT32_MAX || ss >> extra) {
+            return false;
+        }
+    }
+
+    auto type = Device::TYPE_STRINGS.find(type_name);
+    if (type == Device::TYPE_STRINGS.end()) {
+        return false;
+    }
+
+    Predicate predicate{};
+    if (subject_name == "value") {
+        predicate.subject = Subject::VALUE;
+    }
+    else if (subject_name == "delta") {
+        predicate.subject = Subject::DELTA;
+    }
+    else if (subject_name == "rate") {
+        predicate.subject = Subject::RATE;
+    }
+    else {
+        return false;
+    }
+
+    char *end;
+    auto threshold = std::strtod(threshold_str.c_str(), &end);
+    if (*end != '\0' || !std::isfinite(threshold)) {
+        return false;
+    }
+
+    // Every comparison becomes test of closed interval
+    constexpr auto inf = std::numeric_limits<double>::infinity();
+    predicate.lower = -inf;
+    predicate.upper = inf;
+    if (op == ">") {
+        predicate.lower = std::nextafter(threshold, inf);
+    }
+    else if (op == ">=") {
+        predicate.lower = threshold;
+    }
+    else if (op == "<") {
+        predicate.upper = std::nextafter(threshold, -inf);
+    }
+    else if (op == "<=") {
+        predicate.upper = threshold;
+    }
+    else if (op == "==") {
+        predicate.lower = threshold;
+        predicate.upper = threshold;
+    }
+    else {
+        return false;
+    }
+
+    predicate.count = static_cast<uint32_t>(count);
+    predicate.rule = static_cast<uint32_t>(m_rules.size());
+
+    auto first = line.find_first_not_of(" \t");
+    auto last = line.find_last_not_of(" \t\r");
+    m_rules.push_back({name, line.substr(first, last - first + 1)});
+    m_tables[static_cast<size_t>(type->second)].predicates.push_back(predicate);
+
+    return true;
+}
+
+void EHW::AlertEngine::raise(const DataPack &pack, Rule &rule)
+{
+    rule.alerts++;
+
+    *m_output << "Alert: " << rule.name << " device: " << pack.get_id() << " type: "
+              << static_cast<int>(pack.get_type()) << " data: " << pack.get_data() << " ts: " << pack.get_timestamp()
+              << " rule: " << rule.text << std::endl;
+}
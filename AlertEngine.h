@@ -0,0 +1,129 @@
+/**
+ * Author: Matej Postolka <matej@postolka.net>
+ * License: BSD 3-clause
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <array>
+#include <unordered_map>
+#include <fstream>
+#include <ostream>
+
+#include "Device.h"
+
+namespace EHW {
+
+    class DataPack;
+
+    /**
+     * Evaluator of threshold and rate-of-change alert rules on received readings
+     *
+     * Rules are loaded from a file with one rule per line:
+     *
+     *     NAME DEVICE-TYPE SUBJECT OPERATOR THRESHOLD [for COUNT]
+     *
+     * SUBJECT is the numeric value of a reading, its difference from the previous reading of the same device
+     * (delta) or that difference per second (rate). OPERATOR is one of <, <=, >, >=, ==. An alert is raised
+     * once the condition holds for COUNT consecutive readings of a device (default 1) and is raised again only
+     * after the condition stopped holding.
+     *
+     * Rules are compiled into one table of predicates per device type, every predicate being an interval test
+     * of the selected subject. Per-device state of all rules of a type is kept in dense arrays indexed by
+     * device slot.
+     */
+    class AlertEngine final {
+
+    private:
+        enum class Subject : uint8_t {
+            VALUE,
+            DELTA,
+            RATE
+        };
+
+        static constexpr size_t SUBJECT_COUNT = 3;
+
+        /**
+         * Compiled rule, condition holds when lower <= subject <= upper
+         */
+        struct Predicate {
+            double lower;
+            double upper;
+            Subject subject;
+            // Consecutive readings required to raise alert
+            uint32_t count;
+            // Index into m_rules
+            uint32_t rule;
+        };
+
+        /**
+         * Rule as written in rules file, kept for reporting
+         */
+        struct Rule {
+            std::string name;
+            std::string text;
+            uint64_t alerts = 0;
+        };
+
+        /**
+         * Predicates and device state of single device type
+         */
+        struct TypeTable {
+            std::vector<Predicate> predicates;
+            // Slots of devices of this type
+            std::unordered_map<std::string, uint32_t> devices;
+            // Previous value and receive time of every device, indexed by slot
+            std::vector<double> last_values;
+            std::vector<uint64_t> last_times;
+            // Current run of readings satisfying every predicate, indexed by slot * predicates + predicate
+            std::vector<uint32_t> streaks;
+        };
+
+        std::vector<Rule> m_rules;
+        std::array<TypeTable, Device::TYPE_COUNT> m_tables;
+
+        std::ofstream m_file;
+        std::ostream *m_output;
+
+    public:
+        /**
+         * Load and compile rules
+         * @param rules_path Path of rules file
+         * @param alert_path Path of file receiving alerts, standard error output if nullptr
+         * @throws std::runtime_error on unreadable or malformed rules file
+         */
+        explicit AlertEngine(const char *rules_path, const char *alert_path);
+
+        /**
+         * Evaluate all rules of device type of reading
+         * @param pack Data pack
+         */
+        void evaluate(const DataPack &pack);
+
+        /**
+         * Print number of alerts raised by every rule
+         * @param s Output stream
+         */
+        void report(std::ostream &s) const;
+
+    private:
+        /**
+         * Parse single rule and append it to predicate table of its device type
+         * @param line Rule text
+         * @return false if rule is malformed
+         */
+        bool compile(const std::string &line);
+
+        /**
+         * Write alert to alert output
+         * @param pack Data pack raising the alert
+         * @param rule Rule raising the alert
+         */
+        void raise(const DataPack &pack, Rule &rule);
+
+    };
+
+}
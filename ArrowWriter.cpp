@@ -0,0 +1,337 @@
+/**
+ * Author: Matej Postolka <matej@postolka.net>
+ * License: BSD 3-clause
+ */
+
+#include <stdexcept>
+#include <cstdlib>
+#include <utility>
+
+#include "ArrowWriter.h"
+#include "Server.h"
+
+EHW::ArrowWriter::ArrowWriter(Config config) : m_config{std::move(config)},
+                                               m_file_size{0},
+                                               m_file_opened{0},
+                                               m_file_counter{0},
+                                               m_dictionary_written{false},
+                                               m_value_nulls{0},
+                                               m_last_flush{0}
+{
+}
+
+EHW::ArrowWriter::~ArrowWriter()
+{
+    close();
+}
+
+void EHW::ArrowWriter::append(const DataPack &pack)
+{
+    auto now = pack.get_receive_time();
+    if (!m_stream.is_open()) {
+        open_file(now);
+    }
+
+    // Dictionary-encode device identifier
+    auto device_id = pack.get_id();
+    auto it = m_dictionary.find(device_id);
+    if (it == m_dictionary.end()) {
+        it = m_dictionary.emplace(device_id, static_cast<int32_t>(m_dictionary.size())).first;
+        m_dictionary_delta.push_back(std::move(device_id));
+    }
+
+    // Non-numeric values are stored as nulls
+    auto data = pack.get_data();
+    char *end;
+    auto value = std::strtod(data.c_str(), &end);
+    bool valid = !data.empty() && *end == '\0';
+
+    auto row = m_device_ids.size();
+    if (row % 8 == 0) {
+        m_value_validity.push_back(0);
+    }
+    if (valid) {
+        m_value_validity.back() |= static_cast<uint8_t>(1u << (row % 8));
+    }
+    else {
+        value = 0;
+        m_value_nulls++;
+    }
+
+    m_device_ids.push_back(it->second);
+    m_device_types.push_back(static_cast<uint8_t>(pack.get_type()));
+    m_timestamps.push_back(static_cast<int64_t>(now));
+    m_values.push_back(value);
+
+    if (m_device_ids.size() >= BATCH_ROWS) {
+        flush(now);
+    }
+}
+
+void EHW::ArrowWriter::poll(uint64_t now)
+{
+    if (!m_stream.is_open()) {
+        return;
+    }
+
+    if (!m_device_ids.empty() && now - m_last_flush >= FLUSH_INTERVAL) {
+        flush(now);
+    }
+
+    // Rotate by age, next reading opens new file
+    if (now - m_file_opened >= uint64_t{m_config.max_file_age} * 1000000000) {
+        flush(now);
+        close_file();
+    }
+}
+
+void EHW::ArrowWriter::close()
+{
+    if (!m_stream.is_open()) {
+        return;
+    }
+
+    flush(m_last_flush);
+    close_file();
+}
+
+void EHW::ArrowWriter::flush(uint64_t now)
+{
+    m_last_flush = now;
+    if (m_device_ids.empty()) {
+        return;
+    }
+
+    if (!m_dictionary_delta.empty()) {
+        write_dictionary_batch();
+    }
+    write_record_batch();
+
+    m_device_ids.clear();
+    m_device_types.clear();
+    m_timestamps.clear();
+    m_values.clear();
+    m_value_validity.clear();
+    m_value_nulls = 0;
+
+    if (!m_stream) {
+        throw std::runtime_error("cannot write Arrow file");
+    }
+
+    // Rotate by size, next reading opens new file
+    if (m_file_size >= m_config.max_file_size) {
+        close_file();
+    }
+}
+
+void EHW::ArrowWriter::open_file(uint64_t now)
+{
+    auto path = m_config.directory + "/readings-" + std::to_string(now / 1000000000) + "-" +
+                std::to_string(m_file_counter++) + ".arrows";
+
+    m_stream.open(path, std::ios::binary | std::ios::trunc);
+    if (!m_stream) {
+        throw std::runtime_error("cannot open Arrow file for writing");
+    }
+
+    m_file_size = 0;
+    m_file_opened = now;
+    m_last_flush = now;
+
+    // Every file is self-contained, starting with schema and full dictionary
+    m_dictionary.clear();
+    m_dictionary_delta.clear();
+    m_dictionary_written = false;
+
+    write_schema();
+}
+
+void EHW::ArrowWriter::close_file()
+{
+    if (!m_stream.is_open()) {
+        return;
+    }
+
+    // End-of-stream marker
+    uint32_t eos[] = {CONTINUATION, 0};
+    m_stream.write(reinterpret_cast<const char *>(eos), sizeof eos);
+    m_stream.close();
+}
+
+void EHW::ArrowWriter::write_schema()
+{
+    FlatBufferBuilder builder;
+
+    // Dictionary-encoded device identifier
+    builder.start_table();
+    auto utf8_type = builder.end_table();
+    auto index_type = create_int_type(builder, 32, true);
+    builder.start_table();
+    builder.add_scalar<int64_t>(0, DICTIONARY_ID);
+    builder.add_offset(1, index_type);
+    builder.add_scalar<uint8_t>(2, false);
+    auto dictionary = builder.end_table();
+    auto device_id = create_field(builder, "device_id", false, TYPE_UTF8, utf8_type, dictionary);
+
+    auto type_type = create_int_type(builder, 8, false);
+    auto device_type = create_field(builder, "device_type", false, TYPE_INT, type_type, 0);
+
+    auto timezone = builder.create_string("UTC");
+    builder.start_table();
+    builder.add_scalar<int16_t>(0, TIME_UNIT_NANOSECOND);
+    builder.add_offset(1, timezone);
+    auto timestamp_type = builder.end_table();
+    auto timestamp = create_field(builder, "timestamp", false, TYPE_TIMESTAMP, timestamp_type, 0);
+
+    builder.start_table();
+    builder.add_scalar<int16_t>(0, PRECISION_DOUBLE);
+    auto value_type = builder.end_table();
+    auto value = create_field(builder, "value", true, TYPE_FLOATING_POINT, value_type, 0);
+
+    auto fields = builder.create_offset_vector({device_id, device_type, timestamp, value});
+
+    builder.start_table();
+    // Little endian
+    builder.add_scalar<int16_t>(0, 0);
+    builder.add_offset(1, fields);
+    auto schema = builder.end_table();
+
+    write_message(HEADER_SCHEMA, builder, schema, {});
+}
+
+void EHW::ArrowWriter::write_dictionary_batch()
+{
+    std::vector<uint8_t> body;
+    std::vector<int64_t> buffers;
+
+    // Offsets and data of identifiers new since last dictionary batch
+    std::vector<int32_t> offsets{0};
+    std::string data;
+    for (const auto &id : m_dictionary_delta) {
+        data += id;
+        offsets.push_back(static_cast<int32_t>(data.size()));
+    }
+
+    append_buffer(body, buffers, nullptr, 0);
+    append_buffer(body, buffers, offsets.data(), offsets.size() * sizeof(int32_t));
+    append_buffer(body, buffers, data.data(), data.size());
+
+    auto count = static_cast<int64_t>(m_dictionary_delta.size());
+
+    FlatBufferBuilder builder;
+    auto nodes_vector = builder.create_struct_vector({count, 0}, 2);
+    auto buffers_vector = builder.create_struct_vector(buffers, 2);
+    builder.start_table();
+    builder.add_scalar<int64_t>(0, count);
+    builder.add_offset(1, nodes_vector);
+    builder.add_offset(2, buffers_vector);
+    auto record_batch = builder.end_table();
+
+    builder.start_table();
+    builder.add_scalar<int64_t>(0, DICTIONARY_ID);
+    builder.add_offset(1, record_batch);
+    builder.add_scalar<uint8_t>(2, m_dictionary_written);
+    auto dictionary_batch = builder.end_table();
+
+    write_message(HEADER_DICTIONARY_BATCH, builder, dictionary_batch, body);
+
+    m_dictionary_written = true;
+    m_dictionary_delta.clear();
+}
+
+void EHW::ArrowWriter::write_record_batch()
+{
+    auto rows = static_cast<int64_t>(m_device_ids.size());
+    auto nulls = static_cast<int64_t>(m_value_nulls);
+
+    std::vector<uint8_t> body;
+    std::vector<int64_t> buffers;
+
+    // Validity bitmaps may be omitted for columns without nulls
+    append_buffer(body, buffers, nullptr, 0);
+    append_buffer(body, buffers, m_device_ids.data(), m_device_ids.size() * sizeof(int32_t));
+    append_buffer(body, buffers, nullptr, 0);
+    append_buffer(body, buffers, m_device_types.data(), m_device_types.size());
+    append_buffer(body, buffers, nullptr, 0);
+    append_buffer(body, buffers, m_timestamps.data(), m_timestamps.size() * sizeof(int64_t));
+    append_buffer(body, buffers, m_value_validity.data(), nulls > 0 ? m_value_validity.size() : 0);
+    append_buffer(body, buffers, m_values.data(), m_values.size() * sizeof(double));
+
+    FlatBufferBuilder builder;
+    auto nodes_vector = builder.create_struct_vector({rows, 0, rows, 0, rows, 0, rows, nulls}, 2);
+    auto buffers_vector = builder.create_struct_vector(buffers, 2);
+    builder.start_table();
+    builder.add_scalar<int64_t>(0, rows);
+    builder.add_offset(1, nodes_vector);
+    builder.add_offset(2, buffers_vector);
+    auto record_batch = builder.end_table();
+
+    write_message(HEADER_RECORD_BATCH, builder, record_batch, body);
+}
+
+void EHW::ArrowWriter::write_message(uint8_t header_type, FlatBufferBuilder &builder,
+                                     FlatBufferBuilder::Offset header, const std::vector<uint8_t> &body)
+{
+    builder.start_table();
+    builder.add_scalar<int64_t>(3, static_cast<int64_t>(body.size()));
+    builder.add_offset(2, header);
+    builder.add_scalar<int16_t>(0, METADATA_VERSION);
+    builder.add_scalar<uint8_t>(1, header_type);
+    auto message = builder.end_table();
+    auto &metadata = builder.finish(message);
+
+    // Continuation marker and metadata length, metadata padded so that body is 8-byte aligned
+    auto padded_size = static_cast<uint32_t>((metadata.size() + 7) / 8 * 8);
+    uint32_t prefix[] = {CONTINUATION, padded_size};
+    static const char padding[8] = {};
+
+    m_stream.write(reinterpret_cast<const char *>(prefix), sizeof prefix);
+    m_stream.write(reinterpret_cast<const char *>(metadata.data()), metadata.size());
+    m_stream.write(padding, padded_size - metadata.size());
+    m_stream.write(reinterpret_cast<const char *>(body.data()), body.size());
+
+    m_file_size += sizeof prefix + padded_size + body.size();
+}
+
+void EHW::ArrowWriter::append_buffer(std::vector<uint8_t> &body, std::vector<int64_t> &buffers, const void *data,
+                                     size_t len)
+{
+    auto offset = body.size();
+    auto bytes = static_cast<const uint8_t *>(data);
+    body.insert(body.end(), bytes, bytes + len);
+    body.resize((body.size() + 7) / 8 * 8, 0);
+
+    buffers.push_back(static_cast<int64_t>(offset));
+    buffers.push_back(static_cast<int64_t>(len));
+}
+
+EHW::FlatBufferBuilder::Offset EHW::ArrowWriter::create_int_type(FlatBufferBuilder &builder, int32_t bit_width,
+                                                                 bool is_signed)
+{
+    builder.start_table();
+    builder.add_scalar<int32_t>(0, bit_width);
+    builder.add_scalar<uint8_t>(1, is_signed);
+
+    return builder.end_table();
+}
+
+EHW::FlatBufferBuilder::Offset EHW::ArrowWriter::create_field(FlatBufferBuilder &builder, const std::string &name,
+                                                              bool nullable, uint8_t type_type,
+                                                              FlatBufferBuilder::Offset type,
+                                                              FlatBufferBuilder::Offset dictionary)
+{
+    auto name_string = builder.create_string(name);
+    auto children = builder.create_offset_vector({});
+
+    builder.start_table();
+    builder.add_offset(0, name_string);
+    builder.add_scalar<uint8_t>(1, nullable);
+    builder.add_scalar<uint8_t>(2, type_type);
+    builder.add_offset(3, type);
+    if (dictionary != 0) {
+        builder.add_offset(4, dictionary);
+    }
+    builder.add_offset(5, children);
+
+    return builder.end_table();
+}
@@ -0,0 +1,163 @@
+/**
+ * Author: Matej Postolka <matej@postolka.net>
+ * License: BSD 3-clause
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <fstream>
+
+#include "FlatBufferBuilder.h"
+
+namespace EHW {
+
+    class DataPack;
+
+    /**
+     * Writer of received readings into Apache Arrow IPC stream files
+     *
+     * Readings are buffered in columns and written as record batches with schema
+     * (device_id: dictionary<int32, utf8>, device_type: uint8, timestamp: timestamp[ns, UTC], value: float64).
+     * Device identifiers are dictionary-encoded, every batch is preceded by a delta dictionary batch with
+     * identifiers not seen before in the file. Values that are not numeric are stored as nulls. Files are
+     * rotated when they exceed given size or age.
+     */
+    class ArrowWriter final {
+
+    public:
+        struct Config {
+            // Directory receiving the files
+            std::string directory;
+            // Rotate file once it grows past this size in bytes
+            uint64_t max_file_size = 256 * 1024 * 1024;
+            // Rotate file once it is older than this many seconds
+            uint32_t max_file_age = 3600;
+        };
+
+        // Maximum number of rows in single record batch
+        static constexpr size_t BATCH_ROWS = 65536;
+        // Longest time readings are buffered before being written, in nanoseconds
+        static constexpr uint64_t FLUSH_INTERVAL = 1000000000;
+
+    private:
+        // Arrow metadata version V5
+        static constexpr int16_t METADATA_VERSION = 4;
+        // Message header union types
+        static constexpr uint8_t HEADER_SCHEMA = 1;
+        static constexpr uint8_t HEADER_DICTIONARY_BATCH = 2;
+        static constexpr uint8_t HEADER_RECORD_BATCH = 3;
+        // Field type union types
+        static constexpr uint8_t TYPE_INT = 2;
+        static constexpr uint8_t TYPE_FLOATING_POINT = 3;
+        static constexpr uint8_t TYPE_UTF8 = 5;
+        static constexpr uint8_t TYPE_TIMESTAMP = 10;
+        static constexpr int16_t PRECISION_DOUBLE = 2;
+        static constexpr int16_t TIME_UNIT_NANOSECOND = 3;
+        static constexpr int64_t DICTIONARY_ID = 0;
+        static constexpr uint32_t CONTINUATION = 0xffffffff;
+
+        const Config m_config;
+
+        std::ofstream m_stream;
+        uint64_t m_file_size;
+        uint64_t m_file_opened;
+        uint32_t m_file_counter;
+
+        // Dictionary of device identifiers of current file
+        std::unordered_map<std::string, int32_t> m_dictionary;
+        // Identifiers added to dictionary since last dictionary batch
+        std::vector<std::string> m_dictionary_delta;
+        bool m_dictionary_written;
+
+        // Buffered columns
+        std::vector<int32_t> m_device_ids;
+        std::vector<uint8_t> m_device_types;
+        std::vector<int64_t> m_timestamps;
+        std::vector<double> m_values;
+        std::vector<uint8_t> m_value_validity;
+        size_t m_value_nulls;
+        uint64_t m_last_flush;
+
+    public:
+        explicit ArrowWriter(Config config);
+
+        ~ArrowWriter();
+
+        /**
+         * Buffer reading, writing record batch if enough readings are buffered
+         * @param pack Data pack
+         * @throws std::runtime_error
+         */
+        void append(const DataPack &pack);
+
+        /**
+         * Write buffered readings if they are buffered for too long and rotate file if needed
+         * @param now Current time in nanoseconds since epoch
+         * @throws std::runtime_error
+         */
+        void poll(uint64_t now);
+
+        /**
+         * Write buffered readings and finish current file
+         */
+        void close();
+
+    private:
+        /**
+         * Write buffered readings as record batch
+         * @param now Current time in nanoseconds since epoch
+         * @throws std::runtime_error
+         */
+        void flush(uint64_t now);
+
+        /**
+         * Open new file and write schema
+         * @param now Current time in nanoseconds since epoch
+         * @throws std::runtime_error
+         */
+        void open_file(uint64_t now);
+
+        /**
+         * Write end-of-stream marker and close current file
+         */
+        void close_file();
+
+        void write_schema();
+
+        void write_dictionary_batch();
+
+        void write_record_batch();
+
+        /**
+         * Write encapsulated IPC message
+         * @param header_type Type of message header
+         * @param builder Builder with finished header
+         * @param header Offset of header table
+         * @param body Message body
+         */
+        void write_message(uint8_t header_type, FlatBufferBuilder &builder, FlatBufferBuilder::Offset header,
+                           const std::vector<uint8_t> &body);
+
+        /**
+         * Append buffer to message body, padded to 8 bytes
+         * @param body Message body
+         * @param buffers Buffer descriptors (offset, length) of the body
+         * @param data Buffer data
+         * @param len Length of buffer data
+         */
+        static void append_buffer(std::vector<uint8_t> &body, std::vector<int64_t> &buffers, const void *data,
+                                  size_t len);
+
+        static FlatBufferBuilder::Offset create_int_type(FlatBufferBuilder &builder, int32_t bit_width, bool is_signed);
+
+        static FlatBufferBuilder::Offset create_field(FlatBufferBuilder &builder, const std::string &name,
+                                                      bool nullable, uint8_t type_type, FlatBufferBuilder::Offset type,
+                                                      FlatBufferBuilder::Offset dictionary);
+
+    };
+
+}
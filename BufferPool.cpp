@@ -0,0 +1,81 @@
+/**
+ * Author: Matej Postolka <matej@postolka.net>
+ * License: BSD 3-clause
+ */
+
+#include <stdexcept>
+
+#include <sys/mman.h>
+
+#include "BufferPool.h"
+
+EHW::BufferPool::BufferPool(size_t buffer_size, bool huge_pages, MemoryBudget &budget) : m_buffer_size{buffer_size},
+                                                                                         m_huge_pages{huge_pages},
+                                                                                         m_budget{budget},
+                                                                                         m_used{0}
+{
+    if (buffer_size == 0 || buffer_size > REGION_SIZE) {
+        throw std::runtime_error("invalid receive buffer size");
+    }
+}
+
+EHW::BufferPool::~BufferPool()
+{
+    for (auto region : m_regions) {
+        ::munmap(region, REGION_SIZE);
+    }
+    m_budget.release(m_regions.size() * REGION_SIZE);
+}
+
+uint8_t *EHW::BufferPool::acquire()
+{
+    if (m_free.empty() && !grow()) {
+        return nullptr;
+    }
+
+    auto buffer = m_free.back();
+    m_free.pop_back();
+    m_used++;
+
+    return buffer;
+}
+
+void EHW::BufferPool::release(uint8_t *buffer)
+{
+    m_free.push_back(buffer);
+    m_used--;
+}
+
+bool EHW::BufferPool::grow()
+{
+    if (!m_budget.reserve(REGION_SIZE)) {
+        return false;
+    }
+
+    void *region = MAP_FAILED;
+    if (m_huge_pages) {
+        region = ::mmap(nullptr, REGION_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1,
+                        0);
+    }
+    if (region == MAP_FAILED) {
+        // No huge pages reserved by the system, ask for transparent huge pages instead
+        region = ::mmap(nullptr, REGION_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (region == MAP_FAILED) {
+            m_budget.release(REGION_SIZE);
+            return false;
+        }
+        if (m_huge_pages) {
+            ::madvise(region, REGION_SIZE, MADV_HUGEPAGE);
+        }
+    }
+    m_regions.push_back(region);
+
+    // Hand out buffers from region start first
+    auto count = REGION_SIZE / m_buffer_size;
+    auto base = static_cast<uint8_t *>(region);
+    for (size_t i = count; i > 0; i--) {
+        m_free.push_back(base + (i - 1) * m_buffer_size);
+    }
+
+    return true;
+}
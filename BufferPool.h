@@ -0,0 +1,94 @@
+/**
+ * Author: Matej Postolka <matej@postolka.net>
+ * License: BSD 3-clause
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+#include "MemoryBudget.h"
+
+namespace EHW {
+
+    /**
+     * Pool of fixed-size receive buffers
+     *
+     * Buffers are carved from large regions mapped on demand from the memory budget, optionally backed by
+     * huge pages. Regions are kept for the lifetime of the pool, released buffers are reused.
+     */
+    class BufferPool final {
+
+    public:
+        // Size of single mapped region, matches huge page size on x86-64
+        static constexpr size_t REGION_SIZE = 2 * 1024 * 1024;
+
+    private:
+        const size_t m_buffer_size;
+        const bool m_huge_pages;
+        MemoryBudget &m_budget;
+
+        std::vector<void *> m_regions;
+        std::vector<uint8_t *> m_free;
+        size_t m_used;
+
+    public:
+        /**
+         * Create empty pool
+         * @param buffer_size Size of every buffer, at most REGION_SIZE
+         * @param huge_pages Back buffers by huge pages, falls back to regular pages if none are available
+         * @param budget Memory budget regions are reserved from
+         * @throws std::runtime_error on invalid buffer size
+         */
+        explicit BufferPool(size_t buffer_size, bool huge_pages, MemoryBudget &budget);
+
+        ~BufferPool();
+
+        BufferPool(const BufferPool &) = delete;
+
+        BufferPool &operator=(const BufferPool &) = delete;
+
+        /**
+         * Take buffer from pool
+         * @return Buffer of get_buffer_size() bytes, nullptr if memory budget is exhausted
+         */
+        uint8_t *acquire();
+
+        /**
+         * Return buffer to pool
+         * @param buffer Buffer taken from this pool
+         */
+        void release(uint8_t *buffer);
+
+        /**
+         * Check whether a buffer can be acquired
+         * @return true if buffer can be acquired
+         */
+        [[nodiscard]]
+        bool available() const
+        { return !m_free.empty() || m_budget.get_limit() - m_budget.get_used() >= REGION_SIZE; }
+
+        [[nodiscard]]
+        size_t get_buffer_size() const
+        { return m_buffer_size; }
+
+        /**
+         * Get number of buffers currently taken from pool
+         * @return Number of buffers
+         */
+        [[nodiscard]]
+        size_t get_used() const
+        { return m_used; }
+
+    private:
+        /**
+         * Map new region and split it into free buffers
+         * @return false if memory budget is exhausted or mapping failed
+         */
+        bool grow();
+
+    };
+
+}
@@ -0,0 +1,126 @@
+/**
+ * Author: Matej Postolka <matej@postolka.net>
+ * License: BSD 3-clause
+ */
+
+#include <stdexcept>
+#include <iterator>
+#include <algorithm>
+
+#include "Capture.h"
+#include "NetworkTools.h"
+
+EHW::CaptureWriter::CaptureWriter(const char *path) : m_stream{path, std::ios::binary | std::ios::trunc},
+                                                      m_start{std::chrono::steady_clock::now()}
+{
+    if (!m_stream) {
+        throw std::runtime_error("cannot open capture file for writing");
+    }
+
+    m_stream.write(reinterpret_cast<const char *>(CaptureFormat::FILE_MAGIC), sizeof CaptureFormat::FILE_MAGIC);
+    write_int_value(CaptureFormat::FILE_VERSION);
+}
+
+EHW::CaptureWriter::~CaptureWriter()
+{
+    m_stream.flush();
+}
+
+void EHW::CaptureWriter::record_open(uint32_t connection)
+{
+    write_record(CaptureRecord::Event::OPEN, connection, nullptr, 0);
+}
+
+void EHW::CaptureWriter::record_data(uint32_t connection, const uint8_t *data, size_t len)
+{
+    write_record(CaptureRecord::Event::DATA, connection, data, len);
+}
+
+void EHW::CaptureWriter::record_close(uint32_t connection)
+{
+    write_record(CaptureRecord::Event::CLOSE, connection, nullptr, 0);
+}
+
+void EHW::CaptureWriter::write_record(CaptureRecord::Event event, uint32_t connection, const uint8_t *data,
+                                      size_t len)
+{
+    auto elapsed = std::chrono::steady_clock::now() - m_start;
+    auto timestamp = std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+
+    m_stream.put(static_cast<char>(event));
+    write_int_value(connection);
+    write_int_value(static_cast<uint64_t>(timestamp));
+    write_int_value(static_cast<uint32_t>(len));
+    if (len > 0) {
+        m_stream.write(reinterpret_cast<const char *>(data), len);
+    }
+}
+
+template<typename T>
+void EHW::CaptureWriter::write_int_value(T value)
+{
+    auto value_nbo = NetworkTools::endian_swap(value);
+    m_stream.write(reinterpret_cast<const char *>(&value_nbo), sizeof value_nbo);
+}
+
+EHW::CaptureReader::CaptureReader(const char *path) : m_stream{path, std::ios::binary},
+                                                      m_size{0}
+{
+    if (!m_stream) {
+        throw std::runtime_error("cannot open capture file for reading");
+    }
+
+    m_stream.seekg(0, std::ios::end);
+    m_size = static_cast<uint64_t>(m_stream.tellg());
+    m_stream.seekg(0, std::ios::beg);
+
+    uint8_t magic[sizeof CaptureFormat::FILE_MAGIC];
+    m_stream.read(reinterpret_cast<char *>(magic), sizeof magic);
+    if (!m_stream || !std::equal(std::begin(magic), std::end(magic), std::begin(CaptureFormat::FILE_MAGIC))) {
+        throw std::runtime_error("not a capture file");
+    }
+
+    uint32_t version;
+    if (!read_int_value(version) || version != CaptureFormat::FILE_VERSION) {
+        throw std::runtime_error("unsupported capture file version");
+    }
+}
+
+bool EHW::CaptureReader::next(CaptureRecord &record)
+{
+    // End of capture is only valid at record boundary
+    auto event = m_stream.get();
+    if (event == std::char_traits<char>::eof()) {
+        return false;
+    }
+
+    uint32_t len;
+    if (!read_int_value(record.connection) || !read_int_value(record.timestamp) || !read_int_value(len)) {
+        throw std::runtime_error("truncated capture record");
+    }
+
+    // Corrupted length must not allocate more than the file could hold
+    if (len > m_size - static_cast<uint64_t>(m_stream.tellg())) {
+        throw std::runtime_error("truncated capture record");
+    }
+
+    record.event = static_cast<CaptureRecord::Event>(event);
+    record.data.resize(len);
+    if (len > 0 && !m_stream.read(reinterpret_cast<char *>(record.data.data()), len)) {
+        throw std::runtime_error("truncated capture record");
+    }
+
+    return true;
+}
+
+template<typename T>
+bool EHW::CaptureReader::read_int_value(T &value)
+{
+    if (!m_stream.read(reinterpret_cast<char *>(&value), sizeof value)) {
+        return false;
+    }
+
+    value = NetworkTools::endian_swap(value);
+
+    return true;
+}
@@ -0,0 +1,133 @@
+/**
+ * Author: Matej Postolka <matej@postolka.net>
+ * License: BSD 3-clause
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <fstream>
+#include <chrono>
+
+namespace EHW {
+
+    /**
+     * Single event stored in a capture file
+     */
+    struct CaptureRecord {
+
+        // Kind of captured event
+        enum class Event : uint8_t {
+            OPEN,
+            DATA,
+            CLOSE
+        };
+
+        Event event;
+        // Server-assigned identifier of the connection
+        uint32_t connection;
+        // Arrival time in nanoseconds relative to start of capture
+        uint64_t timestamp;
+        // Raw bytes as received from the socket (empty for OPEN/CLOSE)
+        std::vector<uint8_t> data;
+
+    };
+
+    /**
+     * Capture file layout shared by writer and reader
+     *
+     * The file starts with FILE_MAGIC followed by a 32-bit FILE_VERSION. Every record is stored as
+     * an 8-bit event, 32-bit connection ID, 64-bit timestamp and 32-bit data length followed by the
+     * data itself. All integers are stored in network byte order.
+     */
+    class CaptureFormat {
+
+    public:
+        static constexpr uint8_t FILE_MAGIC[] = {'E', 'H', 'W', 'C'};
+        static constexpr uint32_t FILE_VERSION = 1;
+        static constexpr size_t RECORD_HEADER_SIZE = sizeof(uint8_t) + sizeof(uint32_t) + sizeof(uint64_t) +
+                                                     sizeof(uint32_t);
+
+    };
+
+    /**
+     * Records raw inbound byte stream of server connections together with arrival timestamps
+     */
+    class CaptureWriter final {
+
+    private:
+        std::ofstream m_stream;
+        const std::chrono::steady_clock::time_point m_start;
+
+    public:
+        /**
+         * Create capture file, overwriting existing file
+         * @param path Path of capture file
+         * @throws std::runtime_error
+         */
+        explicit CaptureWriter(const char *path);
+
+        ~CaptureWriter();
+
+        /**
+         * Record newly accepted connection
+         * @param connection Connection identifier
+         */
+        void record_open(uint32_t connection);
+
+        /**
+         * Record bytes received on connection
+         * @param connection Connection identifier
+         * @param data Received bytes
+         * @param len Number of received bytes
+         */
+        void record_data(uint32_t connection, const uint8_t *data, size_t len);
+
+        /**
+         * Record closed connection
+         * @param connection Connection identifier
+         */
+        void record_close(uint32_t connection);
+
+    private:
+        void write_record(CaptureRecord::Event event, uint32_t connection, const uint8_t *data, size_t len);
+
+        template<typename T>
+        void write_int_value(T value);
+
+    };
+
+    /**
+     * Sequential reader of capture files
+     */
+    class CaptureReader final {
+
+    private:
+        std::ifstream m_stream;
+        // Size of capture file in bytes
+        uint64_t m_size;
+
+    public:
+        /**
+         * Open capture file and verify its header
+         * @param path Path of capture file
+         * @throws std::runtime_error
+         */
+        explicit CaptureReader(const char *path);
+
+        /**
+         * Read next record from capture
+         * @param record Destination record
+         * @return true if a record was read, false at end of capture
+         * @throws std::runtime_error on truncated or corrupted record
+         */
+        bool next(CaptureRecord &record);
+
+    private:
+        template<typename T>
+        bool read_int_value(T &value);
+
+    };
+
+}
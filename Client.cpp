@@ -5,113 +5,186 @@
 
 #include <stdexcept>
 #include <csignal>
-#include <iostream>
 #include <memory>
+#include <thread>
+#include <array>
 
 #include <unistd.h>
-#include <sys/socket.h>
-#include <arpa/inet.h>
 
 #include "Client.h"
-#include "NetworkTools.h"
+#include "TempMonitor.h"
+#include "UptimeMonitor.h"
 
-bool EHW::Client::s_terminate;
+std::atomic<bool> EHW::Client::s_terminate;
 
 void EHW::Client::signal_setup()
 {
     s_terminate = false;
 
-    // Register SIGINT
-    ::signal(SIGINT, [](int sig) -> void {
-        std::cout << "Caught signal " << sig << ", terminating" << std::endl;
-        s_terminate = true;
+    // Register SIGINT, handler may only use async-signal-safe functions
+    ::signal(SIGINT, [](int) -> void {
+        static const char msg[] = "Caught SIGINT, terminating\n";
+        ::write(STDOUT_FILENO, msg, sizeof msg - 1);
+        s_terminate.store(true);
     });
 }
 
-EHW::Client::Client(const char *server, uint16_t port) : m_server{server},
-                                                         m_port{port},
-                                                         m_socket{-1},
-                                                         m_socket_initialized{false}
+EHW::Client::Client(const char *server, uint16_t port) : m_servers{{server, port}},
+                                                         m_virtual_nodes{HashRing::DEFAULT_VIRTUAL_NODES},
+                                                         m_threads{1},
+                                                         m_connections_per_thread{1},
+                                                         m_sequence_numbers{false},
+                                                         m_batched_devices{0}
 {
 }
 
-EHW::Client::~Client()
-{
-    // Close socket if open
-    close();
-}
-
 void EHW::Client::attach_device(std::unique_ptr<Device> &&device)
 {
+    if (m_sequence_numbers) {
+        device->enable_sequence_numbers();
+    }
+
     m_devices.push_back(std::move(device));
 }
 
-void EHW::Client::run()
+void EHW::Client::attach_device(Device::Type type, const char *identifier, size_t length)
 {
-    connect();
+    std::unique_ptr<Device> device;
+    if (type == Device::Type::TEMP_MONITOR) {
+        device = std::make_unique<TempMonitor>(identifier, length);
+    }
+    else if (type == Device::Type::UPTIME_MONITOR) {
+        device = std::make_unique<UptimeMonitor>(identifier, length);
+    }
+    else {
+        throw std::runtime_error("Unimplemented device type");
+    }
 
-    while (!s_terminate) {
-        // Update devices with fresh internal state
-        update_device_data();
-        // Send data from all devices to server
-        send_device_data();
+    attach_device(std::move(device));
+}
 
-        ::sleep(DATA_SEND_PERIOD);
+void EHW::Client::attach_batched_device(Device::Type type, const char *identifier, size_t length)
+{
+    // One set of batches per worker thread
+    if (m_batches.empty()) {
+        m_batches.resize(m_threads);
     }
+
+    // Shard devices across workers
+    get_batch(m_batched_devices % m_batches.size(), type).add_device(identifier, length);
+    m_batched_devices++;
 }
 
-void EHW::Client::connect()
+void EHW::Client::attach_fleet(FleetFile &fleet, bool batched)
 {
-    ::sockaddr_in remote_addr{};
-    remote_addr.sin_family = AF_INET;
-    remote_addr.sin_port = NetworkTools::endian_swap(m_port);
-
-    if ((m_socket = ::socket(AF_INET, SOCK_STREAM, 0)) < 0) {
-        throw std::runtime_error("cannot create socket");
+    if (m_batches.empty()) {
+        m_batches.resize(m_threads);
     }
 
-    if (::inet_pton(AF_INET, m_server, &remote_addr.sin_addr) != 1) {
-        ::close(m_socket);
-        throw std::runtime_error("invalid IPv4 address");
+    // Count devices and identifier bytes that end up in every batch, sharding them as attach_batched_device
+    struct BatchSize {
+        size_t count = 0;
+        size_t identifier_bytes = 0;
+    };
+    std::vector<std::array<BatchSize, Device::TYPE_COUNT>> sizes(m_batches.size());
+    size_t count = 0;
+
+    FleetEntry entry{};
+    fleet.rewind();
+    while (fleet.next(entry)) {
+        auto &size = sizes[(m_batched_devices + count) % sizes.size()][static_cast<size_t>(entry.type)];
+        size.count++;
+        size.identifier_bytes += entry.length;
+        count++;
     }
 
-    if (::connect(m_socket, (struct sockaddr *) &remote_addr, sizeof remote_addr) < 0) {
-        ::close(m_socket);
-        throw std::runtime_error("cannot connect to server");
+    // Batch columns are preallocated, so that batched devices are constructed in place without reallocation.
+    // Individual devices are still allocated one by one, only the vector of them is reserved
+    if (batched) {
+        for (size_t shard = 0; shard < sizes.size(); shard++) {
+            for (size_t type = 0; type < Device::TYPE_COUNT; type++) {
+                if (sizes[shard][type].count > 0) {
+                    get_batch(shard, static_cast<Device::Type>(type)).reserve(sizes[shard][type].count,
+                                                                              sizes[shard][type].identifier_bytes);
+                }
+            }
+        }
+    }
+    else {
+        m_devices.reserve(m_devices.size() + count);
     }
 
-    m_socket_initialized = true;
+    fleet.rewind();
+    while (fleet.next(entry)) {
+        if (batched) {
+            attach_batched_device(entry.type, entry.identifier, entry.length);
+        }
+        else {
+            attach_device(entry.type, entry.identifier, entry.length);
+        }
+    }
 }
 
-void EHW::Client::close()
+void EHW::Client::run()
 {
-    if (m_socket_initialized) {
-        m_socket_initialized = false;
-        ::close(m_socket);
+    // Do not spawn idle workers
+    auto threads = std::max<size_t>(1, std::min<size_t>(m_threads, m_devices.size() + m_batched_devices));
+
+    std::vector<std::unique_ptr<ClientWorker>> workers;
+    for (size_t i = 0; i < threads; i++) {
+        workers.push_back(std::make_unique<ClientWorker>(m_servers, m_virtual_nodes, m_connections_per_thread,
+                                                         s_terminate));
     }
-}
 
-void EHW::Client::send_device_data()
-{
-    if (!m_socket_initialized) {
-        throw std::runtime_error("socket not initialized, cannot send data");
+    // Shard devices across workers
+    for (size_t i = 0; i < m_devices.size(); i++) {
+        workers[i % threads]->attach_device(std::move(m_devices[i]));
     }
+    m_devices.clear();
 
-    for (auto &d : m_devices) {
-        // Serialize current device state
-        d->serialize();
+    for (size_t i = 0; i < m_batches.size(); i++) {
+        for (auto &item : m_batches[i]) {
+            workers[i % threads]->attach_batch(std::move(item.second));
+        }
+    }
+    m_batches.clear();
+    m_batched_devices = 0;
+
+    std::vector<std::thread> worker_threads;
+    std::vector<std::exception_ptr> errors(threads);
+    for (size_t i = 0; i < threads; i++) {
+        worker_threads.emplace_back([&workers, &errors, i]() {
+            try {
+                workers[i]->run();
+            }
+            catch (...) {
+                // Failure of one worker terminates the whole client
+                errors[i] = std::current_exception();
+                s_terminate = true;
+            }
+        });
+    }
+
+    for (auto &t : worker_threads) {
+        t.join();
+    }
 
-        // Send serialized state to server
-        auto device_buffer = d->get_serialized_buffer();
-        if (::send(m_socket, device_buffer.data(), device_buffer.size(), 0) < 0) {
-            throw std::runtime_error("unable to send data over socket");
+    for (auto &e : errors) {
+        if (e) {
+            std::rethrow_exception(e);
         }
     }
 }
 
-void EHW::Client::update_device_data()
+EHW::DeviceBatch &EHW::Client::get_batch(size_t shard, Device::Type type)
 {
-    for (auto &d : m_devices) {
-        d->update_internal_state();
+    auto &batch = m_batches[shard][type];
+    if (!batch) {
+        batch = DeviceBatch::create(type);
+        if (m_sequence_numbers) {
+            batch->enable_sequence_numbers();
+        }
     }
-}
\ No newline at end of file
+
+    return *batch;
+}
@@ -8,37 +8,81 @@
 #include <vector>
 #include <cstdint>
 #include <memory>
+#include <atomic>
+#include <map>
 
 #include "Device.h"
+#include "DeviceBatch.h"
+#include "FleetFile.h"
+#include "ClientWorker.h"
 
 namespace EHW {
 
     /**
      * A client emulates a selection of devices and sends their data to the server
+     *
+     * Devices are sharded across worker threads, each with its own connections to every server. Devices are
+     * either emulated individually by Device objects, or in bulk by the DeviceBatch engine. With multiple
+     * servers, each device sends its data to one of them, selected by consistent hashing of its identifier.
      */
     class Client final {
 
     private:
-        const char *const m_server;
-        const uint16_t m_port;
+        std::vector<ServerAddress> m_servers;
+        uint32_t m_virtual_nodes;
 
-        int m_socket;
-        bool m_socket_initialized;
+        unsigned m_threads;
+        unsigned m_connections_per_thread;
+        bool m_sequence_numbers;
 
-        // Set by signal handler
-        static bool s_terminate;
+        // Set by signal handler, lock-free so that it may be written from signal context
+        static std::atomic<bool> s_terminate;
+        static_assert(std::atomic<bool>::is_always_lock_free);
 
         std::vector<std::unique_ptr<Device>> m_devices;
+        // Batched devices, one batch per device type and worker thread
+        std::vector<std::map<Device::Type, std::unique_ptr<DeviceBatch>>> m_batches;
+        size_t m_batched_devices;
 
     public:
-        // Period between sending device data in seconds
-        static constexpr int DATA_SEND_PERIOD = 1;
-
         static void signal_setup();
 
         explicit Client(const char *server, uint16_t port);
 
-        ~Client();
+        /**
+         * Add another server receiving data of share of devices
+         * @param server IPv4 address of server
+         * @param port Port of server
+         */
+        void add_server(const std::string &server, uint16_t port)
+        { m_servers.push_back({server, port}); }
+
+        /**
+         * Set number of points of every server on consistent-hash ring
+         * @param virtual_nodes Number of points
+         */
+        void set_virtual_nodes(uint32_t virtual_nodes)
+        { m_virtual_nodes = virtual_nodes; }
+
+        /**
+         * Set number of worker threads emulating devices
+         * @param threads Number of threads
+         */
+        void set_threads(unsigned threads)
+        { m_threads = threads; }
+
+        /**
+         * Set number of connections to every server opened by every worker thread
+         * @param connections Number of connections
+         */
+        void set_connections_per_thread(unsigned connections)
+        { m_connections_per_thread = connections; }
+
+        /**
+         * Attach per-device sequence numbers to data of all devices attached afterwards
+         */
+        void enable_sequence_numbers()
+        { m_sequence_numbers = true; }
 
         /**
          * Attach a new device to the client
@@ -47,32 +91,47 @@ namespace EHW {
         void attach_device(std::unique_ptr<Device> &&device);
 
         /**
-         * Begin emulating devices and sending data to the server
+         * Construct a new device of given type and attach it to the client
+         * @param type Type of device
+         * @param identifier Unique string identifying device
+         * @param length Length of identifier
+         * @throws std::runtime_error if device type is not implemented
          */
-        void run();
+        void attach_device(Device::Type type, const char *identifier, size_t length);
 
-    private:
         /**
-         * Attempt to connect to server
-         * @throws std::runtime_error
+         * Attach a new device emulated by batch engine
+         * @param type Type of device
+         * @param identifier Unique string identifying device
+         * @param length Length of identifier
+         * @throws std::runtime_error if device type has no batch implementation
          */
-        void connect();
+        void attach_batched_device(Device::Type type, const char *identifier, size_t length);
 
         /**
-         * Close socket if open
+         * Attach all devices of fleet definition file, storage of batched devices is allocated upfront
+         * @param fleet Fleet definition file
+         * @param batched Emulate devices by batch engine
+         * @throws std::runtime_error on malformed fleet file
          */
-        void close();
+        void attach_fleet(FleetFile &fleet, bool batched);
 
         /**
-         * Send current values of all attached devices to server
+         * Begin emulating devices and sending data to the server
          * @throws std::runtime_error
          */
-        void send_device_data();
+        void run();
 
+    private:
         /**
-         * Force all devices to refresh their internal states
+         * Get batch of given device type of worker thread, creating it if needed
+         * @param shard Index of worker thread
+         * @param type Type of devices
+         * @return Batch
+         * @throws std::runtime_error if device type has no batch implementation
          */
-        void update_device_data();
+        DeviceBatch &get_batch(size_t shard, Device::Type type);
+
     };
 
-}
\ No newline at end of file
+}
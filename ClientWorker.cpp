@@ -0,0 +1,449 @@
+/**
+ * Author: Matej Postolka <matej@postolka.net>
+ * License: BSD 3-clause
+ */
+
+#include <stdexcept>
+#include <thread>
+#include <iostream>
+#include <cerrno>
+
+#include <unistd.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <arpa/inet.h>
+
+#include "ClientWorker.h"
+#include "NetworkTools.h"
+
+EHW::ClientWorker::ClientWorker(const std::vector<ServerAddress> &servers, uint32_t virtual_nodes,
+                                unsigned connections, const std::atomic<bool> &terminate) : m_terminate{terminate},
+                                                                                            m_ring{virtual_nodes}
+{
+    for (const auto &address : servers) {
+        auto &server = m_servers.emplace_back();
+        server.address = address;
+        server.connections.resize(connections);
+        for (auto &conn : server.connections) {
+            conn.socket = -1;
+            conn.connected = false;
+            conn.tx_offset = 0;
+        }
+        server.connecting = false;
+
+        m_ring.add_node(address.ip + ":" + std::to_string(address.port));
+    }
+}
+
+EHW::ClientWorker::~ClientWorker()
+{
+    // Close sockets if open
+    close();
+}
+
+void EHW::ClientWorker::attach_device(std::unique_ptr<Device> &&device)
+{
+    const auto &id = device->get_id();
+    m_device_hashes.push_back(HashRing::hash(id.data(), id.size()));
+    m_devices.push_back(std::move(device));
+}
+
+void EHW::ClientWorker::attach_batch(std::unique_ptr<DeviceBatch> &&batch)
+{
+    m_batches.push_back(std::move(batch));
+    m_batch_routes.push_back({false, {}});
+}
+
+void EHW::ClientWorker::run()
+{
+    // Servers not reachable at start are retried later, but at least one has to be
+    auto start = Clock::now();
+    for (size_t i = 0; i < m_servers.size(); i++) {
+        m_ring.set_available(i, false);
+        connect(m_servers[i], start);
+    }
+    bool connecting = true;
+    while (connecting) {
+        wait(start + CONNECT_TIMEOUT);
+
+        connecting = false;
+        for (size_t i = 0; i < m_servers.size(); i++) {
+            if (m_servers[i].connecting) {
+                finish_connect(i, Clock::now());
+                connecting |= m_servers[i].connecting;
+            }
+        }
+    }
+
+    bool connected = false;
+    for (size_t i = 0; i < m_servers.size(); i++) {
+        connected |= m_ring.is_available(i);
+    }
+    if (!connected) {
+        throw std::runtime_error("cannot connect to server");
+    }
+    start = Clock::now();
+
+    // All devices produce their first reading immediately
+    for (size_t i = 0; i < m_devices.size(); i++) {
+        m_schedule.push({start, false, i});
+    }
+    for (size_t i = 0; i < m_batches.size(); i++) {
+        m_schedule.push({start, true, i});
+    }
+
+    while (!m_terminate.load(std::memory_order_relaxed)) {
+        reconnect_servers(Clock::now());
+        // Update devices with fresh internal state
+        update_due_devices(Clock::now());
+        // Send data from all updated devices to server
+        send_device_data();
+
+        auto wake = Clock::now() + MAX_SLEEP;
+        if (!m_schedule.empty() && m_schedule.top().due < wake) {
+            wake = m_schedule.top().due;
+        }
+        wait(wake);
+    }
+
+    drain();
+    close();
+}
+
+void EHW::ClientWorker::connect(Server &server, Clock::time_point now)
+{
+    ::sockaddr_in remote_addr{};
+    remote_addr.sin_family = AF_INET;
+    remote_addr.sin_port = NetworkTools::endian_swap(server.address.port);
+
+    if (::inet_pton(AF_INET, server.address.ip.c_str(), &remote_addr.sin_addr) != 1) {
+        throw std::runtime_error("invalid IPv4 address");
+    }
+
+    server.connecting = true;
+    server.retry = now + CONNECT_TIMEOUT;
+    for (auto &conn : server.connections) {
+        if ((conn.socket = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0)) < 0) {
+            disconnect(server);
+            throw std::runtime_error("cannot create socket");
+        }
+
+        if (::connect(conn.socket, (struct sockaddr *) &remote_addr, sizeof remote_addr) == 0) {
+            conn.connected = true;
+        }
+        else if (errno != EINPROGRESS) {
+            disconnect(server);
+            server.retry = now + RECONNECT_DELAY;
+            return;
+        }
+    }
+}
+
+void EHW::ClientWorker::finish_connect(size_t index, Clock::time_point now)
+{
+    auto &server = m_servers[index];
+    bool connected = true;
+    for (auto &conn : server.connections) {
+        if (conn.connected) {
+            continue;
+        }
+
+        auto pfd = ::pollfd{};
+        pfd.fd = conn.socket;
+        pfd.events = POLLOUT;
+        if (::poll(&pfd, 1, 0) <= 0) {
+            connected = false;
+            continue;
+        }
+
+        int error = 0;
+        auto len = static_cast<socklen_t>(sizeof error);
+        if (::getsockopt(conn.socket, SOL_SOCKET, SO_ERROR, &error, &len) < 0 || error != 0) {
+            disconnect(server);
+            server.retry = now + RECONNECT_DELAY;
+            return;
+        }
+        conn.connected = true;
+    }
+
+    if (!connected) {
+        // Host which does not answer at all is retried later
+        if (now >= server.retry) {
+            disconnect(server);
+            server.retry = now + RECONNECT_DELAY;
+        }
+        return;
+    }
+
+    // Devices of the server return to it
+    server.connecting = false;
+    m_ring.set_available(index, true);
+    for (auto &route : m_batch_routes) {
+        route.valid = false;
+    }
+}
+
+void EHW::ClientWorker::disconnect(Server &server)
+{
+    for (auto &conn : server.connections) {
+        if (conn.socket >= 0) {
+            ::close(conn.socket);
+            conn.socket = -1;
+        }
+        conn.connected = false;
+        conn.tx_buffer.clear();
+        conn.tx_offset = 0;
+        conn.blocked_since = {};
+    }
+    server.connecting = false;
+}
+
+void EHW::ClientWorker::close()
+{
+    for (auto &server : m_servers) {
+        disconnect(server);
+    }
+}
+
+void EHW::ClientWorker::fail_server(size_t index)
+{
+    auto &server = m_servers[index];
+    std::cerr << "Lost connection to server " << server.address.ip << ":" << server.address.port
+              << ", moving its devices to remaining servers" << std::endl;
+
+    // Data gathered for the server is lost along with data in flight
+    disconnect(server);
+    server.retry = Clock::now() + RECONNECT_DELAY;
+    m_ring.set_available(index, false);
+    for (auto &route : m_batch_routes) {
+        route.valid = false;
+    }
+}
+
+void EHW::ClientWorker::reconnect_servers(Clock::time_point now)
+{
+    for (size_t i = 0; i < m_servers.size(); i++) {
+        auto &server = m_servers[i];
+        if (m_ring.is_available(i)) {
+            continue;
+        }
+
+        if (!server.connecting && now >= server.retry) {
+            connect(server, now);
+        }
+        if (server.connecting) {
+            finish_connect(i, now);
+        }
+    }
+}
+
+void EHW::ClientWorker::wait(Clock::time_point wake)
+{
+    m_poll_set.clear();
+    for (const auto &server : m_servers) {
+        for (const auto &conn : server.connections) {
+            if (conn.socket >= 0 && (!conn.connected || conn.tx_offset < conn.tx_buffer.size())) {
+                auto pfd = ::pollfd{};
+                pfd.fd = conn.socket;
+                pfd.events = POLLOUT;
+                m_poll_set.push_back(pfd);
+            }
+        }
+    }
+
+    auto now = Clock::now();
+    if (wake <= now) {
+        return;
+    }
+    if (m_poll_set.empty()) {
+        std::this_thread::sleep_until(wake);
+        return;
+    }
+
+    // Round up, so that the wait does not end just before the wake time
+    auto timeout = std::chrono::ceil<std::chrono::milliseconds>(wake - now);
+    ::poll(m_poll_set.data(), m_poll_set.size(), static_cast<int>(timeout.count()));
+}
+
+void EHW::ClientWorker::update_due_devices(Clock::time_point now)
+{
+    while (!m_schedule.empty() && m_schedule.top().due <= now) {
+        auto event = m_schedule.top();
+        m_schedule.pop();
+
+        auto poll_delay = event.batch ? update_batch(event.index) : update_device(event.index);
+
+        // Keep device cadence, but do not try to catch up when falling behind
+        auto delay = std::chrono::milliseconds(poll_delay);
+        event.due += delay;
+        if (event.due <= now) {
+            event.due = now + delay;
+        }
+        m_schedule.push(event);
+    }
+}
+
+uint64_t EHW::ClientWorker::update_device(size_t index)
+{
+    auto &d = m_devices[index];
+    d->update_internal_state();
+
+    // Serialize current device state into buffer of its connection, reading is lost without any server
+    d->serialize();
+    auto server = m_ring.locate(m_device_hashes[index]);
+    if (server == HashRing::NONE) {
+        return d->get_poll_delay();
+    }
+    auto &device_buffer = d->get_serialized_buffer();
+    auto &connections = m_servers[server].connections;
+    auto &tx_buffer = connections[index % connections.size()].tx_buffer;
+    tx_buffer.insert(tx_buffer.end(), device_buffer.begin(), device_buffer.end());
+
+    return d->get_poll_delay();
+}
+
+uint64_t EHW::ClientWorker::update_batch(size_t index)
+{
+    auto &batch = m_batches[index];
+    batch->update_internal_state();
+
+    // Serialize contiguous slice of the batch into buffer of every connection
+    if (m_servers.size() == 1) {
+        auto &server = m_servers.front();
+        if (m_ring.is_available(0)) {
+            auto count = batch->size();
+            auto connections = server.connections.size();
+            for (size_t c = 0; c < connections; c++) {
+                batch->serialize(count * c / connections, count * (c + 1) / connections,
+                                 server.connections[c].tx_buffer);
+            }
+        }
+
+        return batch->get_poll_delay();
+    }
+
+    // Serialize devices of every server, slices of them into buffer of every connection of the server
+    if (!m_batch_routes[index].valid) {
+        route_batch(index);
+    }
+    const auto &route = m_batch_routes[index];
+    for (size_t s = 0; s < m_servers.size(); s++) {
+        const auto &devices = route.devices[s];
+        auto count = devices.size();
+        auto &server = m_servers[s];
+        auto connections = server.connections.size();
+        for (size_t c = 0; c < connections; c++) {
+            auto begin = count * c / connections;
+            auto end = count * (c + 1) / connections;
+            batch->serialize(devices.data() + begin, end - begin, server.connections[c].tx_buffer);
+        }
+    }
+
+    return batch->get_poll_delay();
+}
+
+void EHW::ClientWorker::route_batch(size_t index)
+{
+    const auto &batch = m_batches[index];
+    auto &route = m_batch_routes[index];
+    route.devices.resize(m_servers.size());
+    for (auto &devices : route.devices) {
+        devices.clear();
+    }
+
+    for (size_t i = 0; i < batch->size(); i++) {
+        auto id = batch->get_id(i);
+        auto server = m_ring.locate(HashRing::hash(id.data(), id.size()));
+        if (server != HashRing::NONE) {
+            route.devices[server].push_back(static_cast<uint32_t>(i));
+        }
+    }
+
+    route.valid = true;
+}
+
+void EHW::ClientWorker::send_device_data()
+{
+    for (size_t s = 0; s < m_servers.size(); s++) {
+        if (!m_ring.is_available(s)) {
+            continue;
+        }
+
+        auto now = Clock::now();
+        for (auto &conn : m_servers[s].connections) {
+            if (!write(conn, now)) {
+                fail_server(s);
+                break;
+            }
+        }
+    }
+}
+
+bool EHW::ClientWorker::write(Connection &conn, Clock::time_point now)
+{
+    bool progress = false;
+    while (conn.tx_offset < conn.tx_buffer.size()) {
+        auto len = ::send(conn.socket, conn.tx_buffer.data() + conn.tx_offset,
+                          conn.tx_buffer.size() - conn.tx_offset, MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (len < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                return false;
+            }
+            break;
+        }
+        conn.tx_offset += len;
+        progress = true;
+    }
+
+    if (conn.tx_offset == conn.tx_buffer.size()) {
+        conn.tx_buffer.clear();
+        conn.tx_offset = 0;
+        conn.blocked_since = {};
+        return true;
+    }
+
+    // Server which stopped reading is given up on instead of buffering data for it indefinitely
+    if (progress || conn.blocked_since == Clock::time_point{}) {
+        conn.blocked_since = now;
+    }
+    else if (now - conn.blocked_since >= SEND_TIMEOUT) {
+        return false;
+    }
+    if (conn.tx_buffer.size() - conn.tx_offset > MAX_BUFFERED) {
+        return false;
+    }
+
+    // Avoid moving buffered data on every write
+    if (conn.tx_offset >= COMPACT_THRESHOLD && conn.tx_offset >= conn.tx_buffer.size() / 2) {
+        conn.tx_buffer.erase(conn.tx_buffer.begin(), conn.tx_buffer.begin() + conn.tx_offset);
+        conn.tx_offset = 0;
+    }
+
+    return true;
+}
+
+void EHW::ClientWorker::drain()
+{
+    for (size_t i = 0; i < m_servers.size(); i++) {
+        if (m_servers[i].connecting) {
+            disconnect(m_servers[i]);
+        }
+    }
+
+    auto deadline = Clock::now() + CLOSE_TIMEOUT;
+    while (Clock::now() < deadline) {
+        send_device_data();
+
+        bool unsent = false;
+        for (size_t i = 0; i < m_servers.size(); i++) {
+            for (const auto &conn : m_servers[i].connections) {
+                unsent |= m_ring.is_available(i) && conn.tx_offset < conn.tx_buffer.size();
+            }
+        }
+        if (!unsent) {
+            return;
+        }
+
+        wait(deadline);
+    }
+}
@@ -0,0 +1,261 @@
+/**
+ * Author: Matej Postolka <matej@postolka.net>
+ * License: BSD 3-clause
+ */
+
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <memory>
+#include <atomic>
+#include <chrono>
+#include <queue>
+#include <string>
+
+#include <poll.h>
+
+#include "Device.h"
+#include "DeviceBatch.h"
+#include "HashRing.h"
+
+namespace EHW {
+
+    /**
+     * Address of server receiving device data
+     */
+    struct ServerAddress {
+        // IPv4 address
+        std::string ip;
+        uint16_t port;
+    };
+
+    /**
+     * Emulates a shard of the client's devices on its own thread and connections
+     *
+     * Devices are scheduled individually according to their poll delay, batches of devices as a whole. Data
+     * of all devices due at the same time is gathered per connection and sent with a single call.
+     *
+     * With multiple servers, every device is assigned to one of them by a consistent-hash ring over its
+     * identifier. A server whose connection fails is taken off the ring until it accepts connections again,
+     * which moves only its own devices to the remaining servers.
+     *
+     * Sockets never block the worker, so that a server which stopped responding does not hold up devices of
+     * the others. Connections are established in the background and a server which does not take data for a
+     * while is considered lost.
+     */
+    class ClientWorker final {
+
+    private:
+        using Clock = std::chrono::steady_clock;
+
+        // Longest time spent sleeping before checking for termination
+        static constexpr auto MAX_SLEEP = std::chrono::milliseconds(100);
+        // Delay between attempts to reconnect to unavailable server
+        static constexpr auto RECONNECT_DELAY = std::chrono::seconds(1);
+        // Longest time given to connection attempt
+        static constexpr auto CONNECT_TIMEOUT = std::chrono::seconds(1);
+        // Longest time unsent data may wait without any of it being sent before its server is considered lost
+        static constexpr auto SEND_TIMEOUT = std::chrono::seconds(5);
+        // Most unsent bytes buffered per connection before its server is considered lost
+        static constexpr size_t MAX_BUFFERED = 16 * 1024 * 1024;
+        // Sent bytes are discarded from buffer once they exceed this size and half of the buffer
+        static constexpr size_t COMPACT_THRESHOLD = 64 * 1024;
+        // Time given to unsent data on termination
+        static constexpr auto CLOSE_TIMEOUT = std::chrono::seconds(1);
+
+        /**
+         * Scheduled update of single device or whole batch
+         */
+        struct Event {
+            Clock::time_point due;
+            bool batch;
+            // Index into m_devices or m_batches
+            size_t index;
+
+            bool operator>(const Event &other) const
+            { return due > other.due; }
+        };
+
+        /**
+         * Connection to server with data waiting to be sent
+         */
+        struct Connection {
+            // Non-blocking socket, -1 while disconnected
+            int socket;
+            // Connection was established, otherwise still in progress
+            bool connected;
+            std::vector<uint8_t> tx_buffer;
+            // Bytes of buffer already sent
+            size_t tx_offset;
+            // Last time unsent data made progress, default while all data was sent
+            Clock::time_point blocked_since;
+        };
+
+        /**
+         * Connections to single server
+         */
+        struct Server {
+            ServerAddress address;
+            std::vector<Connection> connections;
+            // Connection attempt is in progress
+            bool connecting;
+            // Earliest time of next connection attempt while unavailable, end of attempt while connecting
+            Clock::time_point retry;
+        };
+
+        /**
+         * Assignment of devices of batch to servers
+         */
+        struct BatchRoute {
+            // Cleared whenever availability of servers changes
+            bool valid;
+            // Indices of devices of batch, per server
+            std::vector<std::vector<uint32_t>> devices;
+        };
+
+        const std::atomic<bool> &m_terminate;
+
+        std::vector<Server> m_servers;
+        // Availability of servers, index of node is index of server
+        HashRing m_ring;
+
+        std::vector<std::unique_ptr<Device>> m_devices;
+        // Ring position of every device
+        std::vector<uint64_t> m_device_hashes;
+        std::vector<std::unique_ptr<DeviceBatch>> m_batches;
+        std::vector<BatchRoute> m_batch_routes;
+        std::priority_queue<Event, std::vector<Event>, std::greater<>> m_schedule;
+
+        // Sockets waited for in single iteration
+        std::vector<::pollfd> m_poll_set;
+
+    public:
+        /**
+         * Create worker
+         * @param servers Servers receiving device data
+         * @param virtual_nodes Number of points of every server on hash ring
+         * @param connections Number of connections opened by worker to every server
+         * @param terminate Flag requesting termination of worker
+         */
+        explicit ClientWorker(const std::vector<ServerAddress> &servers, uint32_t virtual_nodes,
+                              unsigned connections, const std::atomic<bool> &terminate);
+
+        ~ClientWorker();
+
+        ClientWorker(const ClientWorker &) = delete;
+
+        ClientWorker &operator=(const ClientWorker &) = delete;
+
+        /**
+         * Attach a new device to the worker
+         * @param device Device to attach
+         */
+        void attach_device(std::unique_ptr<Device> &&device);
+
+        /**
+         * Attach a new batch of devices to the worker
+         * @param batch Batch to attach
+         */
+        void attach_batch(std::unique_ptr<DeviceBatch> &&batch);
+
+        /**
+         * Connect to server and emulate attached devices until termination is requested
+         * @throws std::runtime_error
+         */
+        void run();
+
+    private:
+        /**
+         * Start opening all connections to server without waiting for them
+         * @param server Server
+         * @param now Current time
+         * @throws std::runtime_error on invalid address
+         */
+        static void connect(Server &server, Clock::time_point now);
+
+        /**
+         * Check connection attempt in progress, putting server on the ring once all its connections are
+         * established and scheduling next attempt if any of them failed or the attempt timed out
+         * @param index Index of server
+         * @param now Current time
+         */
+        void finish_connect(size_t index, Clock::time_point now);
+
+        /**
+         * Close all open connections to server and drop data waiting to be sent
+         * @param server Server
+         */
+        static void disconnect(Server &server);
+
+        /**
+         * Close all open connections
+         */
+        void close();
+
+        /**
+         * Take server off the ring after its connection failed, moving its devices to other servers
+         * @param index Index of server
+         */
+        void fail_server(size_t index);
+
+        /**
+         * Start and check connection attempts of unavailable servers
+         * @param now Current time
+         */
+        void reconnect_servers(Clock::time_point now);
+
+        /**
+         * Wait until given time, or until a socket with unsent data or connection in progress becomes writable
+         * @param wake Latest time of return
+         */
+        void wait(Clock::time_point wake);
+
+        /**
+         * Update and serialize all devices which are due
+         * @param now Current time
+         */
+        void update_due_devices(Clock::time_point now);
+
+        /**
+         * Update and serialize a single device
+         * @param index Index of device
+         * @return Poll delay of device
+         */
+        uint64_t update_device(size_t index);
+
+        /**
+         * Update and serialize all devices of batch, spreading them over all connections of their servers
+         * @param index Index of batch
+         * @return Poll delay of batch
+         */
+        uint64_t update_batch(size_t index);
+
+        /**
+         * Assign devices of batch to currently available servers
+         * @param index Index of batch
+         */
+        void route_batch(size_t index);
+
+        /**
+         * Send gathered data of all connections without blocking, taking servers whose connection failed or
+         * which stopped taking data off the ring
+         */
+        void send_device_data();
+
+        /**
+         * Write buffered data until socket would block
+         * @param conn Connection
+         * @param now Current time
+         * @return false if connection failed or its data cannot be sent
+         */
+        static bool write(Connection &conn, Clock::time_point now);
+
+        /**
+         * Give unsent data of available servers limited time to be sent, abandoning connection attempts
+         */
+        void drain();
+
+    };
+
+}
@@ -0,0 +1,51 @@
+/**
+ * Author: Matej Postolka <matej@postolka.net>
+ * License: BSD 3-clause
+ */
+
+#include <algorithm>
+#include <limits>
+
+#include "CountMinSketch.h"
+
+EHW::CountMinSketch::CountMinSketch(uint32_t width, uint32_t depth) : m_width_mask{round_width(width) - 1},
+                                                                      m_depth{std::max(1u, depth)},
+                                                                      m_counters(size_t{m_width_mask + 1} * m_depth)
+{
+}
+
+uint32_t EHW::CountMinSketch::update(uint64_t hash)
+{
+    auto estimate = std::numeric_limits<uint32_t>::max();
+    for (uint32_t row = 0; row < m_depth; row++) {
+        auto &counter = m_counters[cell(hash, row)];
+        counter++;
+        estimate = std::min(estimate, counter);
+    }
+
+    return estimate;
+}
+
+uint32_t EHW::CountMinSketch::estimate(uint64_t hash) const
+{
+    auto estimate = std::numeric_limits<uint32_t>::max();
+    for (uint32_t row = 0; row < m_depth; row++) {
+        estimate = std::min(estimate, m_counters[cell(hash, row)]);
+    }
+
+    return estimate;
+}
+
+void EHW::CountMinSketch::clear()
+{
+    std::fill(m_counters.begin(), m_counters.end(), 0);
+}
+
+uint32_t EHW::CountMinSketch::round_width(uint32_t width)
+{
+    if (width <= 1) {
+        return 1;
+    }
+
+    return 1u << (32 - __builtin_clz(width - 1));
+}
@@ -0,0 +1,81 @@
+/**
+ * Author: Matej Postolka <matej@postolka.net>
+ * License: BSD 3-clause
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace EHW {
+
+    /**
+     * Count-min sketch estimating per-key counts in fixed memory
+     *
+     * Estimates never undercount, overcounting is bounded by total count divided by width with probability
+     * depending on depth. Row indices are derived from a single 64-bit key hash by double hashing.
+     */
+    class CountMinSketch final {
+
+    private:
+        const uint32_t m_width_mask;
+        const uint32_t m_depth;
+        std::vector<uint32_t> m_counters;
+
+    public:
+        /**
+         * Create empty sketch
+         * @param width Number of counters per row, rounded up to power of two
+         * @param depth Number of rows
+         */
+        explicit CountMinSketch(uint32_t width, uint32_t depth);
+
+        /**
+         * Increment count of key
+         * @param hash Hash of key
+         * @return Estimated count of key after increment
+         */
+        uint32_t update(uint64_t hash);
+
+        /**
+         * Estimate count of key
+         * @param hash Hash of key
+         * @return Estimated count
+         */
+        [[nodiscard]]
+        uint32_t estimate(uint64_t hash) const;
+
+        /**
+         * Reset all counters
+         */
+        void clear();
+
+        /**
+         * Get size of counter storage
+         * @return Size in bytes
+         */
+        [[nodiscard]]
+        size_t get_memory() const
+        { return m_counters.size() * sizeof(uint32_t); }
+
+    private:
+        /**
+         * Round width up to power of two
+         * @param width Requested width
+         * @return Rounded width
+         */
+        static uint32_t round_width(uint32_t width);
+
+        [[nodiscard]]
+        inline size_t cell(uint64_t hash, uint32_t row) const
+        {
+            auto h1 = static_cast<uint32_t>(hash);
+            auto h2 = static_cast<uint32_t>(hash >> 32) | 1;
+
+            return static_cast<size_t>(row) * (m_width_mask + 1) + ((h1 + row * h2) & m_width_mask);
+        }
+
+    };
+
+}
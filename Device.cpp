@@ -4,47 +4,45 @@
  */
 
 #include <map>
+#include <ctime>
+#include <stdexcept>
 
 #include "Device.h"
+#include "Protocol.h"
 
 const std::map<std::string, EHW::Device::Type> EHW::Device::TYPE_STRINGS = {
         {"temp-monitor", Type::TEMP_MONITOR},
         {"uptime-monitor", Type::UPTIME_MONITOR}
 };
 
-EHW::Device::Device(const char *identifier, EHW::Device::Type type) : m_identifier{identifier},
-                                                                      m_type{type}
-{}
-
-void EHW::Device::add_val_to_buffer(uint32_t val)
+EHW::Device::Device(const char *identifier, size_t length, EHW::Device::Type type) : m_identifier(identifier, length),
+                                                                                     m_type{type},
+                                                                                     m_sequence_enabled{false},
+                                                                                     m_sequence{0}
 {
-    // Convert to network byte order
-    auto val_nbo = NetworkTools::endian_swap(val);
-
-    // Insert into buffer
-    auto val_bytes = reinterpret_cast<uint8_t *>(&val_nbo);
-    m_serialized_buffer.insert(m_serialized_buffer.end(), val_bytes, val_bytes + sizeof val_nbo);
+    // Server drops connection sending frame with identifier it cannot accept
+    if (length == 0 || length > Protocol::MAX_ID_LENGTH) {
+        throw std::runtime_error("device identifier must be 1 to " + std::to_string(Protocol::MAX_ID_LENGTH) +
+                                 " bytes long");
+    }
 }
 
-void EHW::Device::add_str_to_buffer(const std::string &str)
+void EHW::Device::serialize_frame(const std::string &value)
 {
-    // Insert 32-bit string length in network byte order
-    add_val_to_buffer(str.length());
-
-    // Insert string
-    m_serialized_buffer.insert(m_serialized_buffer.end(), str.begin(), str.end());
+    Protocol::Frame frame{};
+    frame.type = static_cast<uint32_t>(m_type) | FLAG_SEND_TIMESTAMP;
+    if (m_sequence_enabled) {
+        frame.type |= FLAG_SEQUENCE;
+        frame.sequence = m_sequence++;
+    }
+    frame.id = {reinterpret_cast<const uint8_t *>(m_identifier.data()), static_cast<uint32_t>(m_identifier.size())};
+    frame.data = {reinterpret_cast<const uint8_t *>(value.data()), static_cast<uint32_t>(value.size())};
+
+    // Take send timestamp as late as possible to exclude serialization from measured latency
+    ::timespec now{};
+    ::clock_gettime(CLOCK_REALTIME, &now);
+    frame.send_time = static_cast<uint64_t>(now.tv_sec) * 1000000000 + now.tv_nsec;
+
+    m_serialized_buffer.resize(Protocol::FrameLayout::size(frame));
+    Protocol::FrameLayout::encode(m_serialized_buffer.data(), frame);
 }
-
-void EHW::Device::initialize_buffer()
-{
-    m_serialized_buffer.clear();
-
-    // Insert magic sequence at start of message
-    m_serialized_buffer.insert(m_serialized_buffer.begin(), std::begin(PROTO_MAGIC), std::end(PROTO_MAGIC));
-
-    // Insert 32-bit device type in network byte order
-    add_val_to_buffer(static_cast<uint32_t>(m_type));
-
-    // Insert device identifier
-    add_str_to_buffer(m_identifier);
-}
\ No newline at end of file
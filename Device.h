@@ -29,20 +29,38 @@ namespace EHW {
             UPTIME_MONITOR
         };
 
+        // Number of supported device types
+        static constexpr uint32_t TYPE_COUNT = 2;
+
         static const std::map<std::string, Type> TYPE_STRINGS;
 
+        // Bits of the 32-bit type field carrying the device type, remaining bits carry frame flags
+        static constexpr uint32_t TYPE_MASK = 0x0000ffff;
+        // Frame carries 64-bit send timestamp in nanoseconds since epoch after data
+        static constexpr uint32_t FLAG_SEND_TIMESTAMP = 1u << 31;
+        // Frame carries 32-bit per-device sequence number after send timestamp
+        static constexpr uint32_t FLAG_SEQUENCE = 1u << 30;
+        // Frame carries summary of readings aggregated by relay server instead of single reading
+        static constexpr uint32_t FLAG_SUMMARY = 1u << 29;
+        static constexpr uint32_t KNOWN_FLAGS = FLAG_SEND_TIMESTAMP | FLAG_SEQUENCE | FLAG_SUMMARY;
+
     protected:
         // Unique string identifier of device
         const std::string m_identifier;
         const Type m_type;
         std::vector<uint8_t> m_serialized_buffer;
 
+        bool m_sequence_enabled;
+        uint32_t m_sequence;
+
         /**
          * Constructor of abstract Device class called from subclasses
          * @param identifier Unique string identifying device
+         * @param length Length of identifier
          * @param type Type of device
+         * @throws std::runtime_error if identifier is empty or too long
          */
-        explicit Device(const char *identifier, Type type);
+        explicit Device(const char *identifier, size_t length, Type type);
 
 
     public:
@@ -72,6 +90,12 @@ namespace EHW {
         const inline std::vector<uint8_t> &get_serialized_buffer() const
         { return m_serialized_buffer; }
 
+        /**
+         * Attach per-device sequence number to every serialized frame
+         */
+        void enable_sequence_numbers()
+        { m_sequence_enabled = true; }
+
         /**
          * Abstract method for finding out the delay with which device produces new measurements
          * @return Interval between producing new measurements in milliseconds
@@ -91,21 +115,10 @@ namespace EHW {
 
     protected:
         /**
-         * Insert 32-bit value into buffer in network byte order
-         * @param val Value to insert
-         */
-        virtual void add_val_to_buffer(uint32_t val);
-
-        /**
-         * Insert a string into the buffer prepended with 32-bit length
-         * @param str String to be inserted
-         */
-        virtual void add_str_to_buffer(const std::string &str);
-
-        /**
-         * Insert initial data into serialized buffer
+         * Encode frame carrying current measurement into serialized buffer
+         * @param value Current measurement
          */
-        virtual void initialize_buffer();
+        void serialize_frame(const std::string &value);
 
     };
 
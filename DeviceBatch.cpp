@@ -0,0 +1,68 @@
+/**
+ * Author: Matej Postolka <matej@postolka.net>
+ * License: BSD 3-clause
+ */
+
+#include <stdexcept>
+#include <cstring>
+
+#include "DeviceBatch.h"
+#include "Protocol.h"
+#include "TempMonitorBatch.h"
+#include "UptimeMonitorBatch.h"
+
+EHW::DeviceBatch::DeviceBatch(Device::Type type) : m_type{type},
+                                                   m_sequence_enabled{false},
+                                                   m_identifier_offsets{0}
+{
+}
+
+std::unique_ptr<EHW::DeviceBatch> EHW::DeviceBatch::create(Device::Type type)
+{
+    if (type == Device::Type::TEMP_MONITOR) {
+        return std::make_unique<TempMonitorBatch>();
+    }
+    else if (type == Device::Type::UPTIME_MONITOR) {
+        return std::make_unique<UptimeMonitorBatch>();
+    }
+
+    throw std::runtime_error("Unimplemented device type");
+}
+
+void EHW::DeviceBatch::reserve(size_t count, size_t identifier_bytes)
+{
+    m_identifiers.reserve(m_identifiers.size() + identifier_bytes);
+    m_identifier_offsets.reserve(m_identifier_offsets.size() + count);
+    m_sequences.reserve(size() + count);
+}
+
+void EHW::DeviceBatch::add_device(const char *identifier, size_t length)
+{
+    // Server drops connection sending frame with identifier it cannot accept
+    if (length == 0 || length > Protocol::MAX_ID_LENGTH) {
+        throw std::runtime_error("device identifier must be 1 to " + std::to_string(Protocol::MAX_ID_LENGTH) +
+                                 " bytes long");
+    }
+
+    m_identifiers.insert(m_identifiers.end(), identifier, identifier + length);
+    m_identifier_offsets.push_back(m_identifiers.size());
+    m_sequences.push_back(0);
+}
+
+void EHW::DeviceBatch::enable_sequence_numbers()
+{
+    m_sequence_enabled = true;
+}
+
+uint64_t EHW::DeviceBatch::device_seed(size_t index) const
+{
+    // FNV-1a of identifier
+    uint64_t hash = 0xcbf29ce484222325;
+    auto id_begin = m_identifiers.data() + m_identifier_offsets[index];
+    auto id_end = m_identifiers.data() + m_identifier_offsets[index + 1];
+    for (auto p = id_begin; p != id_end; p++) {
+        hash = (hash ^ *p) * 0x100000001b3;
+    }
+
+    return hash;
+}
@@ -0,0 +1,209 @@
+/**
+ * Author: Matej Postolka <matej@postolka.net>
+ * License: BSD 3-clause
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <string>
+#include <memory>
+#include <cstring>
+#include <ctime>
+#include <string_view>
+#include <type_traits>
+
+#include "Device.h"
+#include "Protocol.h"
+
+namespace EHW {
+
+    /**
+     * Abstract batch of devices of the same type stored as structure of arrays
+     *
+     * Unlike Device, which is updated and serialized one object at a time, a batch updates the state of all
+     * its devices with a single call and serializes frames of a range of devices in bulk. Subclasses store
+     * the device state in columns indexed by device position within the batch.
+     */
+    class DeviceBatch {
+
+    protected:
+        const Device::Type m_type;
+        bool m_sequence_enabled;
+
+        // Identifiers of all devices stored back to back
+        std::vector<uint8_t> m_identifiers;
+        // Offsets of individual identifiers in m_identifiers, with extra trailing offset
+        std::vector<size_t> m_identifier_offsets;
+        std::vector<uint32_t> m_sequences;
+
+        /**
+         * Constructor of abstract DeviceBatch class called from subclasses
+         * @param type Type of devices in batch
+         */
+        explicit DeviceBatch(Device::Type type);
+
+    public:
+        virtual ~DeviceBatch() = default;
+
+        /**
+         * Create empty batch for given device type
+         * @param type Type of devices
+         * @return New batch
+         * @throws std::runtime_error if device type has no batch implementation
+         */
+        static std::unique_ptr<DeviceBatch> create(Device::Type type);
+
+        [[nodiscard]]
+        auto inline get_type() const
+        { return m_type; }
+
+        /**
+         * Get number of devices in batch
+         * @return Number of devices
+         */
+        [[nodiscard]]
+        size_t size() const
+        { return m_sequences.size(); }
+
+        /**
+         * Get identifier of device
+         * @param index Index of device
+         * @return Identifier
+         */
+        [[nodiscard]]
+        std::string_view get_id(size_t index) const
+        {
+            return {reinterpret_cast<const char *>(m_identifiers.data()) + m_identifier_offsets[index],
+                    m_identifier_offsets[index + 1] - m_identifier_offsets[index]};
+        }
+
+        /**
+         * Reserve storage for given number of devices added to batch afterwards
+         * @param count Number of added devices
+         * @param identifier_bytes Total length of identifiers of added devices
+         */
+        virtual void reserve(size_t count, size_t identifier_bytes);
+
+        /**
+         * Add device to batch
+         * @param identifier Unique string identifying device
+         * @param length Length of identifier
+         * @throws std::runtime_error if identifier is empty or too long
+         */
+        virtual void add_device(const char *identifier, size_t length);
+
+        /**
+         * Attach per-device sequence numbers to all serialized frames
+         */
+        void enable_sequence_numbers();
+
+        /**
+         * Abstract method for finding out the delay with which devices produce new measurements
+         * @return Interval between producing new measurements in milliseconds
+         */
+        [[nodiscard]]
+        virtual uint64_t get_poll_delay() const = 0;
+
+        /**
+         * Abstract method updating internal state of all devices to latest reading/value
+         */
+        virtual void update_internal_state() = 0;
+
+        /**
+         * Abstract method serializing current measurements of range of devices and appending them to buffer
+         * @param begin Index of first device
+         * @param end Index past last device
+         * @param buffer Destination buffer
+         */
+        virtual void serialize(size_t begin, size_t end, std::vector<uint8_t> &buffer) = 0;
+
+        /**
+         * Abstract method serializing current measurements of selected devices and appending them to buffer
+         * @param indices Indices of devices
+         * @param count Number of devices
+         * @param buffer Destination buffer
+         */
+        virtual void serialize(const uint32_t *indices, size_t count, std::vector<uint8_t> &buffer) = 0;
+
+    protected:
+        /**
+         * Serialize frames of devices, called from subclasses with their value formatter
+         * @tparam MaxValueLength Longest string written by formatter
+         * @tparam Index Index of device, or pointer into array of indices of selected devices
+         * @tparam F Callable with signature char *(size_t index, char *dest) writing value of device as string
+         * @param begin First device
+         * @param end Past last device
+         * @param buffer Destination buffer
+         * @param format Value formatter
+         */
+        template<size_t MaxValueLength, typename Index, typename F>
+        void serialize_frames(Index begin, Index end, std::vector<uint8_t> &buffer, F &&format)
+        {
+            if (begin >= end) {
+                return;
+            }
+
+            auto index_of = [](Index it) -> size_t {
+                if constexpr (std::is_pointer_v<Index>) {
+                    return *it;
+                }
+                else {
+                    return it;
+                }
+            };
+
+            Protocol::Frame frame{};
+            frame.type = static_cast<uint32_t>(m_type) | Device::FLAG_SEND_TIMESTAMP;
+            if (m_sequence_enabled) {
+                frame.type |= Device::FLAG_SEQUENCE;
+            }
+
+            // Single send timestamp shared by the whole range
+            ::timespec now{};
+            ::clock_gettime(CLOCK_REALTIME, &now);
+            frame.send_time = static_cast<uint64_t>(now.tv_sec) * 1000000000 + now.tv_nsec;
+
+            // Reserve room for the largest possible frames and shrink afterwards
+            size_t identifiers_len = 0;
+            if constexpr (std::is_pointer_v<Index>) {
+                for (auto it = begin; it != end; it++) {
+                    identifiers_len += m_identifier_offsets[*it + 1] - m_identifier_offsets[*it];
+                }
+            }
+            else {
+                identifiers_len = m_identifier_offsets[end] - m_identifier_offsets[begin];
+            }
+            auto offset = buffer.size();
+            buffer.resize(offset + identifiers_len + (end - begin) * (Protocol::FRAME_OVERHEAD + MaxValueLength));
+
+            auto dest = buffer.data() + offset;
+            char value[MaxValueLength];
+            for (auto it = begin; it != end; it++) {
+                auto i = index_of(it);
+                frame.id = {m_identifiers.data() + m_identifier_offsets[i],
+                            static_cast<uint32_t>(m_identifier_offsets[i + 1] - m_identifier_offsets[i])};
+                frame.data = {reinterpret_cast<const uint8_t *>(value),
+                              static_cast<uint32_t>(format(i, value) - value)};
+                if (m_sequence_enabled) {
+                    frame.sequence = m_sequences[i]++;
+                }
+
+                dest = Protocol::FrameLayout::encode(dest, frame);
+            }
+
+            buffer.resize(dest - buffer.data());
+        }
+
+        /**
+         * Seed for random generators of device, derived from its identifier
+         * @param index Index of device
+         * @return Seed
+         */
+        [[nodiscard]]
+        uint64_t device_seed(size_t index) const;
+
+    };
+
+}
@@ -0,0 +1,150 @@
+/**
+ * Author: Matej Postolka <matej@postolka.net>
+ * License: BSD 3-clause
+ */
+
+#include <algorithm>
+
+#include "DeviceSketch.h"
+
+EHW::DeviceSketch::DeviceSketch(const Config &config) : m_config{config},
+                                                        m_counts{config.width, config.depth},
+                                                        m_distinct{config.precision},
+                                                        m_window_start{0},
+                                                        m_window_messages{0}
+{
+    m_top.reserve(m_config.top_k);
+    m_top_index.reserve(m_config.top_k * 2);
+}
+
+uint64_t EHW::DeviceSketch::hash(const std::string &device_id)
+{
+    // FNV-1a followed by murmur3 finalizer for well mixed high bits
+    uint64_t h = 0xcbf29ce484222325;
+    for (auto c : device_id) {
+        h = (h ^ static_cast<uint8_t>(c)) * 0x100000001b3;
+    }
+
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccd;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53;
+    h ^= h >> 33;
+
+    return h;
+}
+
+void EHW::DeviceSketch::update(const std::string &device_id, uint64_t now, std::ostream &s)
+{
+    if (m_window_start == 0) {
+        m_window_start = now;
+    }
+    else if (now - m_window_start >= uint64_t{m_config.window} * 1000000000) {
+        report(s);
+        clear(now);
+    }
+
+    auto h = hash(device_id);
+    m_window_messages++;
+    m_distinct.update(h);
+
+    auto count = m_counts.update(h);
+
+    // Devices quieter than the quietest heavy hitter cannot be in the heap, as estimates only grow
+    if (m_top.size() == m_config.top_k && (m_top.empty() || count <= m_top.front().count)) {
+        return;
+    }
+    update_top(device_id, h, count);
+}
+
+void EHW::DeviceSketch::report(std::ostream &s) const
+{
+    s << "Sketch window: messages: " << m_window_messages
+      << " distinct devices: ~" << static_cast<uint64_t>(m_distinct.estimate() + 0.5) << std::endl;
+
+    auto top = m_top;
+    std::sort(top.begin(), top.end(), [](const HeavyHitter &a, const HeavyHitter &b) {
+        return a.count > b.count;
+    });
+    for (const auto &item : top) {
+        s << "Device: " << item.device_id << "\testimated messages: " << item.count << std::endl;
+    }
+}
+
+size_t EHW::DeviceSketch::get_memory() const
+{
+    return m_counts.get_memory() + m_distinct.get_memory() + m_config.top_k * sizeof(HeavyHitter);
+}
+
+void EHW::DeviceSketch::update_top(const std::string &device_id, uint64_t hash, uint32_t count)
+{
+    auto it = m_top_index.find(hash);
+    if (it != m_top_index.end()) {
+        // Count of tracked device grew, move it away from the root
+        m_top[it->second].count = count;
+        sift_down(it->second);
+        return;
+    }
+
+    if (m_top.size() < m_config.top_k) {
+        m_top.push_back({device_id, hash, count});
+        m_top_index[hash] = m_top.size() - 1;
+        sift_up(m_top.size() - 1);
+        return;
+    }
+
+    // Replace the quietest heavy hitter
+    m_top_index.erase(m_top.front().hash);
+    m_top.front() = {device_id, hash, count};
+    m_top_index[hash] = 0;
+    sift_down(0);
+}
+
+void EHW::DeviceSketch::sift_up(size_t pos)
+{
+    while (pos > 0) {
+        auto parent = (pos - 1) / 2;
+        if (m_top[parent].count <= m_top[pos].count) {
+            break;
+        }
+        swap_entries(parent, pos);
+        pos = parent;
+    }
+}
+
+void EHW::DeviceSketch::sift_down(size_t pos)
+{
+    while (true) {
+        auto smallest = pos;
+        auto left = 2 * pos + 1;
+        auto right = left + 1;
+        if (left < m_top.size() && m_top[left].count < m_top[smallest].count) {
+            smallest = left;
+        }
+        if (right < m_top.size() && m_top[right].count < m_top[smallest].count) {
+            smallest = right;
+        }
+        if (smallest == pos) {
+            break;
+        }
+        swap_entries(smallest, pos);
+        pos = smallest;
+    }
+}
+
+void EHW::DeviceSketch::swap_entries(size_t a, size_t b)
+{
+    std::swap(m_top[a], m_top[b]);
+    m_top_index[m_top[a].hash] = a;
+    m_top_index[m_top[b].hash] = b;
+}
+
+void EHW::DeviceSketch::clear(uint64_t now)
+{
+    m_counts.clear();
+    m_distinct.clear();
+    m_top.clear();
+    m_top_index.clear();
+    m_window_start = now;
+    m_window_messages = 0;
+}
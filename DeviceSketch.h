@@ -0,0 +1,113 @@
+/**
+ * Author: Matej Postolka <matej@postolka.net>
+ * License: BSD 3-clause
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <ostream>
+
+#include "CountMinSketch.h"
+#include "HyperLogLog.h"
+
+namespace EHW {
+
+    /**
+     * Bounded-memory statistics of devices sending data to the server
+     *
+     * Tracks the noisiest devices with a count-min sketch feeding a top-K heap, and the number of distinct
+     * devices with HyperLogLog. Statistics are collected over fixed time windows, a report is produced when
+     * a window ends.
+     */
+    class DeviceSketch final {
+
+    public:
+        struct Config {
+            // Counters per row of count-min sketch
+            uint32_t width = 65536;
+            // Rows of count-min sketch
+            uint32_t depth = 4;
+            // Number of noisiest devices tracked
+            uint32_t top_k = 16;
+            // HyperLogLog precision, 2^precision registers
+            uint32_t precision = 14;
+            // Length of window in seconds
+            uint32_t window = 60;
+        };
+
+    private:
+        struct HeavyHitter {
+            std::string device_id;
+            uint64_t hash;
+            uint32_t count;
+        };
+
+        const Config m_config;
+        CountMinSketch m_counts;
+        HyperLogLog m_distinct;
+
+        // Min-heap of noisiest devices ordered by estimated count
+        std::vector<HeavyHitter> m_top;
+        // Position of devices in heap indexed by hash
+        std::unordered_map<uint64_t, size_t> m_top_index;
+
+        // Start of current window in nanoseconds since epoch, 0 before first update
+        uint64_t m_window_start;
+        uint64_t m_window_messages;
+
+    public:
+        explicit DeviceSketch(const Config &config);
+
+        /**
+         * Hash device identifier for use with sketches
+         * @param device_id Device identifier
+         * @return 64-bit hash
+         */
+        static uint64_t hash(const std::string &device_id);
+
+        /**
+         * Account message from device, reporting and resetting statistics if window ended
+         * @param device_id Device identifier
+         * @param now Receive time in nanoseconds since epoch
+         * @param s Output stream for window report
+         */
+        void update(const std::string &device_id, uint64_t now, std::ostream &s);
+
+        /**
+         * Print statistics of current window
+         * @param s Output stream
+         */
+        void report(std::ostream &s) const;
+
+        /**
+         * Get size of fixed sketch storage
+         * @return Size in bytes
+         */
+        [[nodiscard]]
+        size_t get_memory() const;
+
+    private:
+        /**
+         * Offer device with its estimated count to top-K heap
+         */
+        void update_top(const std::string &device_id, uint64_t hash, uint32_t count);
+
+        void sift_up(size_t pos);
+
+        void sift_down(size_t pos);
+
+        void swap_entries(size_t a, size_t b);
+
+        /**
+         * Reset statistics for new window
+         * @param now Start of new window
+         */
+        void clear(uint64_t now);
+
+    };
+
+}
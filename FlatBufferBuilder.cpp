@@ -0,0 +1,114 @@
+/**
+ * Author: Matej Postolka <matej@postolka.net>
+ * License: BSD 3-clause
+ */
+
+#include "FlatBufferBuilder.h"
+
+EHW::FlatBufferBuilder::FlatBufferBuilder() : m_min_align{1},
+                                              m_table_start{0}
+{
+}
+
+EHW::FlatBufferBuilder::Offset EHW::FlatBufferBuilder::create_string(const std::string &str)
+{
+    // Length prefix, characters and terminating zero
+    align(sizeof(uint32_t), str.size() + 1);
+    m_buffer.insert(m_buffer.begin(), 0);
+    m_buffer.insert(m_buffer.begin(), str.begin(), str.end());
+    push(static_cast<uint32_t>(str.size()));
+
+    return size();
+}
+
+EHW::FlatBufferBuilder::Offset EHW::FlatBufferBuilder::create_offset_vector(const std::vector<Offset> &offsets)
+{
+    align(sizeof(uint32_t), offsets.size() * sizeof(uint32_t));
+    for (auto it = offsets.rbegin(); it != offsets.rend(); it++) {
+        push_offset(*it);
+    }
+    push(static_cast<uint32_t>(offsets.size()));
+
+    return size();
+}
+
+EHW::FlatBufferBuilder::Offset EHW::FlatBufferBuilder::create_struct_vector(const std::vector<int64_t> &values,
+                                                                          size_t struct_size)
+{
+    // Length prefix must directly precede 8-byte aligned elements
+    align(sizeof(uint32_t), values.size() * sizeof(int64_t));
+    align(sizeof(int64_t), values.size() * sizeof(int64_t));
+    for (auto it = values.rbegin(); it != values.rend(); it++) {
+        push(*it);
+    }
+    push(static_cast<uint32_t>(values.size() / struct_size));
+
+    return size();
+}
+
+void EHW::FlatBufferBuilder::start_table()
+{
+    m_fields.clear();
+    m_table_start = size();
+}
+
+void EHW::FlatBufferBuilder::add_offset(uint16_t field, Offset offset)
+{
+    align(sizeof(uint32_t), 0);
+    push_offset(offset);
+    m_fields.emplace_back(field, size());
+}
+
+EHW::FlatBufferBuilder::Offset EHW::FlatBufferBuilder::end_table()
+{
+    // Placeholder for offset of vtable
+    align(sizeof(int32_t), 0);
+    push(int32_t{0});
+    auto table = size();
+
+    uint16_t max_field = 0;
+    for (const auto &field : m_fields) {
+        max_field = std::max<uint16_t>(max_field, field.first + 1);
+    }
+
+    // Vtable holds its own size, size of table and position of every field within table
+    std::vector<uint16_t> vtable(2 + max_field, 0);
+    vtable[0] = static_cast<uint16_t>(vtable.size() * sizeof(uint16_t));
+    vtable[1] = static_cast<uint16_t>(table - m_table_start);
+    for (const auto &field : m_fields) {
+        vtable[2 + field.first] = static_cast<uint16_t>(table - field.second);
+    }
+    for (auto it = vtable.rbegin(); it != vtable.rend(); it++) {
+        push(*it);
+    }
+
+    // Table refers to vtable preceding it
+    auto vtable_offset = static_cast<int32_t>(size() - table);
+    std::memcpy(m_buffer.data() + (size() - table), &vtable_offset, sizeof vtable_offset);
+
+    m_fields.clear();
+
+    return table;
+}
+
+const std::vector<uint8_t> &EHW::FlatBufferBuilder::finish(Offset root)
+{
+    align(m_min_align, sizeof(uint32_t));
+    push_offset(root);
+
+    return m_buffer;
+}
+
+void EHW::FlatBufferBuilder::align(size_t alignment, size_t additional)
+{
+    m_min_align = std::max(m_min_align, alignment);
+
+    auto padding = (alignment - (m_buffer.size() + additional) % alignment) % alignment;
+    m_buffer.insert(m_buffer.begin(), padding, 0);
+}
+
+void EHW::FlatBufferBuilder::push_offset(Offset offset)
+{
+    align(sizeof(uint32_t), 0);
+    push(static_cast<uint32_t>(size() + sizeof(uint32_t) - offset));
+}
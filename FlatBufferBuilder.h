@@ -0,0 +1,134 @@
+/**
+ * Author: Matej Postolka <matej@postolka.net>
+ * License: BSD 3-clause
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include <string>
+#include <algorithm>
+
+namespace EHW {
+
+    /**
+     * Minimal builder of FlatBuffers binary encoding, sufficient for Arrow IPC metadata
+     *
+     * As in the reference implementation the buffer is built back to front, so that children are written
+     * before their parents. Objects are referred to by their offset from the end of the buffer. Only
+     * little-endian hosts are supported, which is what the rest of the code assumes as well.
+     */
+    class FlatBufferBuilder final {
+
+    public:
+        // Reference to object already written into the buffer
+        using Offset = uint32_t;
+
+    private:
+        // Bytes of the buffer, front of the vector is the front of the buffer
+        std::vector<uint8_t> m_buffer;
+        size_t m_min_align;
+
+        // Fields of table being built as pairs of field ID and offset
+        std::vector<std::pair<uint16_t, Offset>> m_fields;
+        Offset m_table_start;
+
+    public:
+        FlatBufferBuilder();
+
+        /**
+         * Current size of buffer, also the offset of the last written object
+         * @return Size in bytes
+         */
+        [[nodiscard]]
+        Offset size() const
+        { return static_cast<Offset>(m_buffer.size()); }
+
+        /**
+         * Write string
+         * @param str String
+         * @return Offset of string
+         */
+        Offset create_string(const std::string &str);
+
+        /**
+         * Write vector of references to objects
+         * @param offsets Offsets of objects
+         * @return Offset of vector
+         */
+        Offset create_offset_vector(const std::vector<Offset> &offsets);
+
+        /**
+         * Write vector of structs consisting of 64-bit integers (Arrow FieldNode and Buffer)
+         * @param values All struct members in order
+         * @param struct_size Number of members of a single struct
+         * @return Offset of vector
+         */
+        Offset create_struct_vector(const std::vector<int64_t> &values, size_t struct_size);
+
+        /**
+         * Begin new table, fields are added with add_* methods
+         */
+        void start_table();
+
+        /**
+         * Add scalar field to table being built
+         * @tparam T Scalar type
+         * @param field Field ID
+         * @param value Value
+         */
+        template<typename T>
+        void add_scalar(uint16_t field, T value)
+        {
+            align(sizeof value, sizeof value);
+            push(value);
+            m_fields.emplace_back(field, size());
+        }
+
+        /**
+         * Add reference to object to table being built
+         * @param field Field ID
+         * @param offset Offset of object
+         */
+        void add_offset(uint16_t field, Offset offset);
+
+        /**
+         * Finish table being built
+         * @return Offset of table
+         */
+        Offset end_table();
+
+        /**
+         * Finish buffer with given root table
+         * @param root Offset of root table
+         * @return Finished buffer
+         */
+        const std::vector<uint8_t> &finish(Offset root);
+
+    private:
+        /**
+         * Insert padding so that after writing additional bytes the buffer is aligned
+         * @param alignment Required alignment
+         * @param additional Number of bytes to be written
+         */
+        void align(size_t alignment, size_t additional);
+
+        template<typename T>
+        void push(T value)
+        {
+            uint8_t bytes[sizeof value];
+            std::memcpy(bytes, &value, sizeof value);
+            m_buffer.insert(m_buffer.begin(), bytes, bytes + sizeof value);
+        }
+
+        /**
+         * Write reference to object at current position
+         * @param offset Offset of object
+         */
+        void push_offset(Offset offset);
+
+    };
+
+}
@@ -0,0 +1,129 @@
+/**
+ * Author: Matej Postolka <matej@postolka.net>
+ * License: BSD 3-clause
+ */
+
+#include <stdexcept>
+#include <cstring>
+#include <string>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "FleetFile.h"
+#include "Protocol.h"
+
+EHW::FleetFile::FleetFile(const char *path) : m_fd{-1},
+                                              m_data{nullptr},
+                                              m_size{0},
+                                              m_position{0},
+                                              m_line{0}
+{
+    m_fd = ::open(path, O_RDONLY);
+    if (m_fd < 0) {
+        throw std::runtime_error("cannot open fleet file");
+    }
+
+    struct ::stat st{};
+    if (::fstat(m_fd, &st) < 0) {
+        ::close(m_fd);
+        throw std::runtime_error("cannot stat fleet file");
+    }
+
+    // Empty file cannot be mapped, it simply has no devices
+    m_size = st.st_size;
+    if (m_size == 0) {
+        return;
+    }
+
+    auto data = ::mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE | MAP_POPULATE, m_fd, 0);
+    if (data == MAP_FAILED) {
+        ::close(m_fd);
+        throw std::runtime_error("cannot map fleet file");
+    }
+    ::madvise(data, m_size, MADV_SEQUENTIAL);
+    m_data = static_cast<const char *>(data);
+}
+
+EHW::FleetFile::~FleetFile()
+{
+    if (m_data) {
+        ::munmap(const_cast<char *>(m_data), m_size);
+    }
+    ::close(m_fd);
+}
+
+bool EHW::FleetFile::next(FleetEntry &entry)
+{
+    auto is_space = [](char c) { return c == ' ' || c == '\t' || c == '\r'; };
+
+    while (m_position < m_size) {
+        auto line = m_data + m_position;
+        auto end = static_cast<const char *>(std::memchr(line, '\n', m_size - m_position));
+        if (!end) {
+            end = m_data + m_size;
+        }
+        m_position = end - m_data + 1;
+        m_line++;
+
+        auto p = line;
+        while (p != end && is_space(*p)) {
+            p++;
+        }
+        if (p == end || *p == '#') {
+            continue;
+        }
+
+        // Device type
+        auto type = p;
+        while (p != end && !is_space(*p)) {
+            p++;
+        }
+        auto type_length = p - type;
+        while (p != end && is_space(*p)) {
+            p++;
+        }
+
+        // Device identifier
+        auto identifier = p;
+        while (p != end && !is_space(*p)) {
+            p++;
+        }
+        auto identifier_length = p - identifier;
+        while (p != end && is_space(*p)) {
+            p++;
+        }
+
+        if (identifier_length == 0 || p != end) {
+            throw std::runtime_error("malformed fleet file line " + std::to_string(m_line));
+        }
+        if (!find_type(type, type_length, entry.type)) {
+            throw std::runtime_error("unknown device type on fleet file line " + std::to_string(m_line));
+        }
+        if (static_cast<size_t>(identifier_length) > Protocol::MAX_ID_LENGTH) {
+            throw std::runtime_error("device identifier longer than " + std::to_string(Protocol::MAX_ID_LENGTH) +
+                                     " bytes on fleet file line " + std::to_string(m_line));
+        }
+
+        entry.identifier = identifier;
+        entry.length = identifier_length;
+
+        return true;
+    }
+
+    return false;
+}
+
+bool EHW::FleetFile::find_type(const char *name, size_t length, Device::Type &type)
+{
+    for (const auto &item : Device::TYPE_STRINGS) {
+        if (item.first.size() == length && std::memcmp(item.first.data(), name, length) == 0) {
+            type = item.second;
+            return true;
+        }
+    }
+
+    return false;
+}
@@ -0,0 +1,85 @@
+/**
+ * Author: Matej Postolka <matej@postolka.net>
+ * License: BSD 3-clause
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+#include "Device.h"
+
+namespace EHW {
+
+    /**
+     * Single device of fleet definition, identifier points into the mapped file and is not terminated
+     */
+    struct FleetEntry {
+        Device::Type type;
+        const char *identifier;
+        size_t length;
+    };
+
+    /**
+     * Sequential reader of fleet definition files
+     *
+     * Every line of the file holds one device as DEVICE-TYPE DEVICE-ID separated by spaces or tabs. Empty
+     * lines and lines starting with # are ignored. The file is memory-mapped and tokenized in place, so that
+     * loading does not copy or allocate per device.
+     */
+    class FleetFile final {
+
+    private:
+        int m_fd;
+        const char *m_data;
+        size_t m_size;
+
+        // Position of next line to parse
+        size_t m_position;
+        size_t m_line;
+
+    public:
+        /**
+         * Map fleet file into memory
+         * @param path Path of fleet file
+         * @throws std::runtime_error
+         */
+        explicit FleetFile(const char *path);
+
+        ~FleetFile();
+
+        FleetFile(const FleetFile &) = delete;
+
+        FleetFile &operator=(const FleetFile &) = delete;
+
+        /**
+         * Parse next device of fleet
+         * @param entry Destination entry
+         * @return true if a device was parsed, false at end of file
+         * @throws std::runtime_error on malformed line, unknown device type or too long identifier
+         */
+        bool next(FleetEntry &entry);
+
+        /**
+         * Restart reading from beginning of file
+         */
+        void rewind()
+        {
+            m_position = 0;
+            m_line = 0;
+        }
+
+    private:
+        /**
+         * Look up device type by its name without copying it
+         * @param name Name of device type
+         * @param length Length of name
+         * @param type Destination type
+         * @return true if type is known
+         */
+        static bool find_type(const char *name, size_t length, Device::Type &type);
+
+    };
+
+}
@@ -0,0 +1,73 @@
+/**
+ * Author: Matej Postolka <matej@postolka.net>
+ * License: BSD 3-clause
+ */
+
+#include <stdexcept>
+#include <algorithm>
+
+#include "HashRing.h"
+
+EHW::HashRing::HashRing(uint32_t virtual_nodes) : m_virtual_nodes{virtual_nodes},
+                                                  m_available_count{0}
+{
+    if (virtual_nodes == 0) {
+        throw std::runtime_error("hash ring needs at least one virtual node per node");
+    }
+}
+
+uint64_t EHW::HashRing::hash(const char *data, size_t length)
+{
+    // FNV-1a, finalized by splitmix64 to spread similar keys over the whole ring
+    uint64_t hash = 0xcbf29ce484222325;
+    for (size_t i = 0; i < length; i++) {
+        hash = (hash ^ static_cast<uint8_t>(data[i])) * 0x100000001b3;
+    }
+
+    hash = (hash ^ (hash >> 30)) * 0xbf58476d1ce4e5b9;
+    hash = (hash ^ (hash >> 27)) * 0x94d049bb133111eb;
+
+    return hash ^ (hash >> 31);
+}
+
+void EHW::HashRing::add_node(const std::string &name)
+{
+    auto node = static_cast<uint32_t>(m_available.size());
+    m_available.push_back(true);
+    m_available_count++;
+
+    for (uint32_t i = 0; i < m_virtual_nodes; i++) {
+        auto point_name = name + "#" + std::to_string(i);
+        m_points.push_back({hash(point_name.data(), point_name.size()), node});
+    }
+    std::sort(m_points.begin(), m_points.end());
+}
+
+void EHW::HashRing::set_available(uint32_t node, bool available)
+{
+    if (m_available[node] != available) {
+        m_available[node] = available;
+        m_available_count += available ? 1 : -1;
+    }
+}
+
+uint32_t EHW::HashRing::locate(uint64_t key_hash) const
+{
+    if (m_available_count == 0) {
+        return NONE;
+    }
+
+    auto it = std::lower_bound(m_points.begin(), m_points.end(), Point{key_hash, 0});
+
+    // Walk clockwise past points of unavailable nodes, wrapping around the end
+    for (size_t i = 0; i < m_points.size(); i++, it++) {
+        if (it == m_points.end()) {
+            it = m_points.begin();
+        }
+        if (m_available[it->node]) {
+            return it->node;
+        }
+    }
+
+    return NONE;
+}
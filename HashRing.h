@@ -0,0 +1,98 @@
+/**
+ * Author: Matej Postolka <matej@postolka.net>
+ * License: BSD 3-clause
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace EHW {
+
+    /**
+     * Consistent-hash ring assigning keys to nodes
+     *
+     * Every node is placed on the ring at a number of pseudo-random points (virtual nodes), a key belongs to
+     * the node owning the first point at or after the key's hash. Unavailable nodes are skipped, so that
+     * only keys of such node move, each to the next available node along the ring, and return once the node
+     * is available again.
+     */
+    class HashRing final {
+
+    public:
+        // Result of locate() when no node is available
+        static constexpr uint32_t NONE = UINT32_MAX;
+        // Default number of points of every node
+        static constexpr uint32_t DEFAULT_VIRTUAL_NODES = 128;
+
+    private:
+        struct Point {
+            uint64_t hash;
+            uint32_t node;
+
+            bool operator<(const Point &other) const
+            { return hash < other.hash || (hash == other.hash && node < other.node); }
+        };
+
+        const uint32_t m_virtual_nodes;
+
+        // Points of all nodes ordered by hash
+        std::vector<Point> m_points;
+        std::vector<bool> m_available;
+        size_t m_available_count;
+
+    public:
+        /**
+         * Create empty ring
+         * @param virtual_nodes Number of points of every node
+         * @throws std::runtime_error if virtual_nodes is zero
+         */
+        explicit HashRing(uint32_t virtual_nodes = DEFAULT_VIRTUAL_NODES);
+
+        /**
+         * Hash key or node name
+         * @param data Key
+         * @param length Length of key
+         * @return 64-bit hash
+         */
+        static uint64_t hash(const char *data, size_t length);
+
+        /**
+         * Place available node on ring, nodes are numbered in order of addition
+         * @param name Name of node, which determines its points
+         */
+        void add_node(const std::string &name);
+
+        /**
+         * Mark node available or unavailable
+         * @param node Index of node
+         * @param available New state
+         */
+        void set_available(uint32_t node, bool available);
+
+        [[nodiscard]]
+        bool is_available(uint32_t node) const
+        { return m_available[node]; }
+
+        /**
+         * Get number of nodes
+         * @return Number of nodes
+         */
+        [[nodiscard]]
+        size_t size() const
+        { return m_available.size(); }
+
+        /**
+         * Find node owning key
+         * @param key_hash Hash of key
+         * @return Index of first available node along the ring, NONE if no node is available
+         */
+        [[nodiscard]]
+        uint32_t locate(uint64_t key_hash) const;
+
+    };
+
+}
@@ -0,0 +1,55 @@
+/**
+ * Author: Matej Postolka <matej@postolka.net>
+ * License: BSD 3-clause
+ */
+
+#include <algorithm>
+#include <cmath>
+
+#include "HyperLogLog.h"
+
+EHW::HyperLogLog::HyperLogLog(uint32_t precision) : m_precision{std::clamp(precision, MIN_PRECISION,
+                                                                           MAX_PRECISION)},
+                                                    m_registers(size_t{1} << m_precision)
+{
+}
+
+double EHW::HyperLogLog::estimate() const
+{
+    auto m = static_cast<double>(m_registers.size());
+
+    double sum = 0;
+    size_t zeros = 0;
+    for (auto reg : m_registers) {
+        sum += std::ldexp(1.0, -reg);
+        zeros += reg == 0;
+    }
+
+    double alpha;
+    if (m_registers.size() == 16) {
+        alpha = 0.673;
+    }
+    else if (m_registers.size() == 32) {
+        alpha = 0.697;
+    }
+    else if (m_registers.size() == 64) {
+        alpha = 0.709;
+    }
+    else {
+        alpha = 0.7213 / (1 + 1.079 / m);
+    }
+
+    auto raw = alpha * m * m / sum;
+
+    // Linear counting is more accurate for small cardinalities
+    if (raw <= 2.5 * m && zeros > 0) {
+        return m * std::log(m / zeros);
+    }
+
+    return raw;
+}
+
+void EHW::HyperLogLog::clear()
+{
+    std::fill(m_registers.begin(), m_registers.end(), 0);
+}
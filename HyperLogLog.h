@@ -0,0 +1,72 @@
+/**
+ * Author: Matej Postolka <matej@postolka.net>
+ * License: BSD 3-clause
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace EHW {
+
+    /**
+     * HyperLogLog estimator of number of distinct keys in fixed memory
+     *
+     * Uses 2^precision one-byte registers, standard error is about 1.04 / sqrt(2^precision).
+     */
+    class HyperLogLog final {
+
+    public:
+        static constexpr uint32_t MIN_PRECISION = 4;
+        static constexpr uint32_t MAX_PRECISION = 18;
+
+    private:
+        const uint32_t m_precision;
+        std::vector<uint8_t> m_registers;
+
+    public:
+        /**
+         * Create empty estimator
+         * @param precision Number of hash bits selecting register, clamped to supported range
+         */
+        explicit HyperLogLog(uint32_t precision);
+
+        /**
+         * Add key to estimator
+         * @param hash Hash of key
+         */
+        inline void update(uint64_t hash)
+        {
+            auto index = hash >> (64 - m_precision);
+            // Guard bit bounds the rank if remaining bits are all zero
+            auto rest = (hash << m_precision) | (uint64_t{1} << (m_precision - 1));
+            auto rank = static_cast<uint8_t>(__builtin_clzll(rest) + 1);
+
+            auto &reg = m_registers[index];
+            reg = reg < rank ? rank : reg;
+        }
+
+        /**
+         * Estimate number of distinct keys added
+         * @return Estimated cardinality
+         */
+        [[nodiscard]]
+        double estimate() const;
+
+        /**
+         * Reset all registers
+         */
+        void clear();
+
+        /**
+         * Get size of register storage
+         * @return Size in bytes
+         */
+        [[nodiscard]]
+        size_t get_memory() const
+        { return m_registers.size(); }
+
+    };
+
+}
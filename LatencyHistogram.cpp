@@ -0,0 +1,112 @@
+/**
+ * Author: Matej Postolka <matej@postolka.net>
+ * License: BSD 3-clause
+ */
+
+#include <limits>
+#include <algorithm>
+
+#include "LatencyHistogram.h"
+
+EHW::LatencyHistogram::LatencyHistogram() : m_counts{},
+                                            m_count{0},
+                                            m_min{std::numeric_limits<uint64_t>::max()},
+                                            m_max{0},
+                                            m_negative{0}
+{
+}
+
+void EHW::LatencyHistogram::record(uint64_t send_ns, uint64_t receive_ns)
+{
+    // Clamp skewed samples to zero but keep track of them
+    uint64_t latency = 0;
+    if (receive_ns >= send_ns) {
+        latency = receive_ns - send_ns;
+    }
+    else {
+        m_negative++;
+    }
+
+    m_counts[bucket_index(latency)]++;
+    m_count++;
+    m_min = std::min(m_min, latency);
+    m_max = std::max(m_max, latency);
+}
+
+void EHW::LatencyHistogram::merge(const LatencyHistogram &other)
+{
+    for (unsigned i = 0; i < BUCKETS; i++) {
+        m_counts[i] += other.m_counts[i];
+    }
+    m_count += other.m_count;
+    m_min = std::min(m_min, other.m_min);
+    m_max = std::max(m_max, other.m_max);
+    m_negative += other.m_negative;
+}
+
+uint64_t EHW::LatencyHistogram::get_percentile(double percentile) const
+{
+    if (m_count == 0) {
+        return 0;
+    }
+
+    auto rank = static_cast<uint64_t>(percentile / 100.0 * m_count + 0.5);
+    rank = std::max<uint64_t>(1, std::min(rank, m_count));
+
+    uint64_t seen = 0;
+    for (unsigned i = 0; i < BUCKETS; i++) {
+        seen += m_counts[i];
+        if (seen >= rank) {
+            return std::min(bucket_upper_bound(i), m_max);
+        }
+    }
+
+    return m_max;
+}
+
+void EHW::LatencyHistogram::print(std::ostream &s) const
+{
+    if (m_count == 0) {
+        s << "no samples";
+        return;
+    }
+
+    s << "samples: " << m_count
+      << " min: " << m_min / 1e3
+      << " p50: " << get_percentile(50) / 1e3
+      << " p90: " << get_percentile(90) / 1e3
+      << " p99: " << get_percentile(99) / 1e3
+      << " p99.9: " << get_percentile(99.9) / 1e3
+      << " max: " << m_max / 1e3 << " us";
+
+    if (m_negative > 0) {
+        s << " (" << m_negative << " skewed)";
+    }
+}
+
+unsigned EHW::LatencyHistogram::bucket_index(uint64_t value)
+{
+    // Small values map to buckets directly
+    if (value < SUB_BUCKETS) {
+        return value;
+    }
+
+    // Position of highest set bit selects the group, following bits select the sub-bucket
+    unsigned shift = 63 - __builtin_clzll(value) - SUB_BUCKET_BITS;
+    unsigned sub = (value >> shift) - SUB_BUCKETS;
+
+    return (shift + 1) * SUB_BUCKETS + sub;
+}
+
+uint64_t EHW::LatencyHistogram::bucket_upper_bound(unsigned index)
+{
+    if (index < SUB_BUCKETS) {
+        return index;
+    }
+
+    unsigned shift = index / SUB_BUCKETS - 1;
+    uint64_t sub = index % SUB_BUCKETS;
+    uint64_t lower = (SUB_BUCKETS + sub) << shift;
+
+    return lower + ((uint64_t{1} << shift) - 1);
+}
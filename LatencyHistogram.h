@@ -0,0 +1,80 @@
+/**
+ * Author: Matej Postolka <matej@postolka.net>
+ * License: BSD 3-clause
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <array>
+#include <ostream>
+
+namespace EHW {
+
+    /**
+     * Fixed-size log-linear histogram of nanosecond latencies
+     *
+     * Values are grouped by their highest set bit, each power of two being split into SUB_BUCKETS linear
+     * sub-buckets, which bounds the relative error of reported percentiles to 1 / SUB_BUCKETS. Recording
+     * a value is O(1) and never allocates.
+     */
+    class LatencyHistogram final {
+
+    private:
+        static constexpr unsigned SUB_BUCKET_BITS = 3;
+        static constexpr unsigned SUB_BUCKETS = 1u << SUB_BUCKET_BITS;
+        static constexpr unsigned BUCKETS = (64 - SUB_BUCKET_BITS + 1) * SUB_BUCKETS;
+
+        std::array<uint64_t, BUCKETS> m_counts;
+        uint64_t m_count;
+        uint64_t m_min;
+        uint64_t m_max;
+        // Samples with receive time preceding send time (clock skew between hosts)
+        uint64_t m_negative;
+
+    public:
+        LatencyHistogram();
+
+        /**
+         * Record single latency sample
+         * @param send_ns Send timestamp in nanoseconds
+         * @param receive_ns Receive timestamp in nanoseconds
+         */
+        void record(uint64_t send_ns, uint64_t receive_ns);
+
+        /**
+         * Merge samples of another histogram into this one
+         * @param other Histogram to merge
+         */
+        void merge(const LatencyHistogram &other);
+
+        /**
+         * Get approximate latency at given percentile
+         * @param percentile Percentile in range 0-100
+         * @return Latency in nanoseconds (upper bound of bucket)
+         */
+        [[nodiscard]]
+        uint64_t get_percentile(double percentile) const;
+
+        [[nodiscard]]
+        inline uint64_t get_count() const
+        { return m_count; }
+
+        [[nodiscard]]
+        inline uint64_t get_negative() const
+        { return m_negative; }
+
+        /**
+         * Print summary of recorded latencies in microseconds
+         * @param s Output stream
+         */
+        void print(std::ostream &s) const;
+
+    private:
+        static unsigned bucket_index(uint64_t value);
+
+        static uint64_t bucket_upper_bound(unsigned index);
+
+    };
+
+}
@@ -0,0 +1,78 @@
+/**
+ * Author: Matej Postolka <matej@postolka.net>
+ * License: BSD 3-clause
+ */
+
+#include <cstring>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+#include "MagicSearch.h"
+#include "Device.h"
+
+size_t EHW::MagicSearch::find(const uint8_t *data, size_t len)
+{
+    constexpr auto magic_len = sizeof Device::PROTO_MAGIC;
+    size_t i = 0;
+
+#if defined(__AVX2__)
+    const auto m0 = _mm256_set1_epi8(static_cast<char>(Device::PROTO_MAGIC[0]));
+    const auto m1 = _mm256_set1_epi8(static_cast<char>(Device::PROTO_MAGIC[1]));
+    const auto m2 = _mm256_set1_epi8(static_cast<char>(Device::PROTO_MAGIC[2]));
+    const auto m3 = _mm256_set1_epi8(static_cast<char>(Device::PROTO_MAGIC[3]));
+
+    // Compare 32 candidate positions at once, each byte of the magic against a shifted load
+    for (; i + 32 + magic_len - 1 <= len; i += 32) {
+        auto b0 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i));
+        auto b1 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i + 1));
+        auto b2 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i + 2));
+        auto b3 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i + 3));
+
+        auto eq = _mm256_and_si256(_mm256_and_si256(_mm256_cmpeq_epi8(b0, m0), _mm256_cmpeq_epi8(b1, m1)),
+                                   _mm256_and_si256(_mm256_cmpeq_epi8(b2, m2), _mm256_cmpeq_epi8(b3, m3)));
+
+        auto mask = static_cast<uint32_t>(_mm256_movemask_epi8(eq));
+        if (mask != 0) {
+            return i + __builtin_ctz(mask);
+        }
+    }
+#elif defined(__SSE2__)
+    const auto m0 = _mm_set1_epi8(static_cast<char>(Device::PROTO_MAGIC[0]));
+    const auto m1 = _mm_set1_epi8(static_cast<char>(Device::PROTO_MAGIC[1]));
+    const auto m2 = _mm_set1_epi8(static_cast<char>(Device::PROTO_MAGIC[2]));
+    const auto m3 = _mm_set1_epi8(static_cast<char>(Device::PROTO_MAGIC[3]));
+
+    // Compare 16 candidate positions at once, each byte of the magic against a shifted load
+    for (; i + 16 + magic_len - 1 <= len; i += 16) {
+        auto b0 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+        auto b1 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i + 1));
+        auto b2 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i + 2));
+        auto b3 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i + 3));
+
+        auto eq = _mm_and_si128(_mm_and_si128(_mm_cmpeq_epi8(b0, m0), _mm_cmpeq_epi8(b1, m1)),
+                                _mm_and_si128(_mm_cmpeq_epi8(b2, m2), _mm_cmpeq_epi8(b3, m3)));
+
+        auto mask = static_cast<uint32_t>(_mm_movemask_epi8(eq));
+        if (mask != 0) {
+            return i + __builtin_ctz(mask);
+        }
+    }
+#endif
+
+    return find_scalar(data, i, len);
+}
+
+size_t EHW::MagicSearch::find_scalar(const uint8_t *data, size_t start, size_t len)
+{
+    constexpr auto magic_len = sizeof Device::PROTO_MAGIC;
+
+    for (auto i = start; i + magic_len <= len; i++) {
+        if (std::memcmp(data + i, Device::PROTO_MAGIC, magic_len) == 0) {
+            return i;
+        }
+    }
+
+    return len;
+}
@@ -0,0 +1,35 @@
+/**
+ * Author: Matej Postolka <matej@postolka.net>
+ * License: BSD 3-clause
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+namespace EHW {
+
+    /**
+     * Vectorized search for Device::PROTO_MAGIC in received data
+     *
+     * Uses AVX2 or SSE2 depending on target instruction set, with scalar fallback for other targets
+     * and for the tail of the buffer.
+     */
+    class MagicSearch {
+
+    public:
+        /**
+         * Find first occurrence of protocol magic sequence
+         * @param data Buffer to search
+         * @param len Length of buffer
+         * @return Offset of magic sequence, len if not found
+         */
+        static size_t find(const uint8_t *data, size_t len);
+
+    private:
+        static size_t find_scalar(const uint8_t *data, size_t start, size_t len);
+
+    };
+
+}
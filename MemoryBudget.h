@@ -0,0 +1,68 @@
+/**
+ * Author: Matej Postolka <matej@postolka.net>
+ * License: BSD 3-clause
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+namespace EHW {
+
+    /**
+     * Server-wide limit of memory held by connections
+     *
+     * Allocators of connection state and receive buffers reserve memory here before obtaining it from the
+     * system, and fail gracefully instead once the limit would be exceeded.
+     */
+    class MemoryBudget final {
+
+    private:
+        const size_t m_limit;
+        size_t m_used;
+
+    public:
+        /**
+         * Create budget
+         * @param limit Limit in bytes
+         */
+        explicit MemoryBudget(size_t limit) : m_limit{limit},
+                                              m_used{0}
+        {
+        }
+
+        /**
+         * Reserve memory
+         * @param bytes Number of bytes
+         * @return false if reservation would exceed the limit
+         */
+        bool reserve(size_t bytes)
+        {
+            if (bytes > m_limit - m_used) {
+                return false;
+            }
+
+            m_used += bytes;
+
+            return true;
+        }
+
+        /**
+         * Return reserved memory
+         * @param bytes Number of bytes
+         */
+        void release(size_t bytes)
+        { m_used -= bytes; }
+
+        [[nodiscard]]
+        size_t get_limit() const
+        { return m_limit; }
+
+        [[nodiscard]]
+        size_t get_used() const
+        { return m_used; }
+
+    };
+
+}
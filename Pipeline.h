@@ -0,0 +1,377 @@
+/**
+ * Author: Matej Postolka <matej@postolka.net>
+ * License: BSD 3-clause
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <functional>
+#include <exception>
+#include <algorithm>
+#include <ostream>
+#include <csignal>
+
+#include <pthread.h>
+
+#include "SpscQueue.h"
+
+namespace EHW {
+
+    /**
+     * Staged pipeline handing items from network stage through processing threads to sink thread
+     *
+     * The network stage, running on the thread which owns the pipeline, submits items together with a handle,
+     * which selects the processing thread. All items with the same handle are thus processed by the same
+     * thread, in order, so that processing threads may own state partitioned by handle without locking.
+     * Processed items are passed to a single sink thread.
+     *
+     * Items travel in batches over lock-free single-producer single-consumer queues, one from the network
+     * stage to every processing thread and one from every processing thread to the sink. A partially filled
+     * batch is handed over as soon as its processing thread is idle, batch size grows while the thread falls
+     * behind and shrinks back while it keeps up. Full queues stall the stage feeding them, which eventually
+     * stops reading from the network.
+     *
+     * Asynchronous signals are blocked in pipeline threads and thus delivered to the network stage.
+     *
+     * @tparam T Type of items
+     */
+    template<typename T>
+    class Pipeline final {
+
+    public:
+        // Processing stage, called with index of processing thread
+        using Process = std::function<void(size_t processor, T &item)>;
+        // Sink stage
+        using Sink = std::function<void(T &item)>;
+        // Periodic work of sink thread, called between batches
+        using Idle = std::function<void()>;
+
+        // Number of batches queued between stages
+        static constexpr size_t QUEUE_CAPACITY = 256;
+        // Bounds of adaptive batch size
+        static constexpr size_t MIN_BATCH_SIZE = 16;
+        static constexpr size_t MAX_BATCH_SIZE = 4096;
+
+    private:
+        // Sleep of thread with empty input queues
+        static constexpr auto IDLE_SLEEP = std::chrono::microseconds(100);
+
+        struct Batch {
+            std::vector<T> items;
+        };
+
+        using BatchQueue = SpscQueue<std::unique_ptr<Batch>>;
+
+        /**
+         * Statistics of single queue, written by its producer
+         */
+        struct QueueStats {
+            std::atomic<uint64_t> batches{0};
+            std::atomic<uint64_t> items{0};
+            std::atomic<uint64_t> max_depth{0};
+            // Number of times producer found queue full
+            std::atomic<uint64_t> stalls{0};
+        };
+
+        struct Processor {
+            BatchQueue input{QUEUE_CAPACITY};
+            BatchQueue output{QUEUE_CAPACITY};
+            QueueStats input_stats;
+            QueueStats output_stats;
+
+            // Batch being filled by network stage and size at which it is handed over
+            std::unique_ptr<Batch> pending;
+            size_t batch_size = MIN_BATCH_SIZE;
+
+            std::thread thread;
+        };
+
+        const Process m_process;
+        const Sink m_sink;
+        const Idle m_idle;
+
+        std::vector<std::unique_ptr<Processor>> m_processors;
+        std::thread m_sink_thread;
+        bool m_running;
+
+        std::atomic<bool> m_stopping;
+        std::atomic<bool> m_processors_done;
+        // Set by first stage throwing exception, which is rethrown to network stage
+        std::atomic<bool> m_failed;
+        std::exception_ptr m_error;
+
+    public:
+        /**
+         * Create stopped pipeline
+         * @param processors Number of processing threads
+         * @param process Processing stage
+         * @param sink Sink stage
+         * @param idle Periodic work of sink thread, may be empty
+         */
+        explicit Pipeline(size_t processors, Process process, Sink sink, Idle idle) : m_process{std::move(process)},
+                                                                                     m_sink{std::move(sink)},
+                                                                                     m_idle{std::move(idle)},
+                                                                                     m_running{false},
+                                                                                     m_stopping{false},
+                                                                                     m_processors_done{false},
+                                                                                     m_failed{false}
+        {
+            for (size_t i = 0; i < processors; i++) {
+                m_processors.push_back(std::make_unique<Processor>());
+            }
+        }
+
+        ~Pipeline()
+        {
+            stop();
+        }
+
+        Pipeline(const Pipeline &) = delete;
+
+        Pipeline &operator=(const Pipeline &) = delete;
+
+        /**
+         * Start processing and sink threads
+         */
+        void start()
+        {
+            // Threads inherit signal mask of their creator
+            ::sigset_t signals, previous;
+            ::sigfillset(&signals);
+            ::pthread_sigmask(SIG_BLOCK, &signals, &previous);
+
+            m_running = true;
+            for (size_t i = 0; i < m_processors.size(); i++) {
+                m_processors[i]->thread = std::thread(&Pipeline::run_processor, this, i);
+            }
+            m_sink_thread = std::thread(&Pipeline::run_sink, this);
+
+            ::pthread_sigmask(SIG_SETMASK, &previous, nullptr);
+        }
+
+        /**
+         * Hand over remaining items, wait until all of them reach the sink and stop all threads
+         */
+        void stop()
+        {
+            if (!m_running) {
+                return;
+            }
+            m_running = false;
+
+            for (auto &p : m_processors) {
+                if (p->pending && !p->pending->items.empty()) {
+                    push(*p);
+                }
+            }
+
+            // Processing threads drain their queues before stopping, the sink drains after all of them stopped
+            m_stopping.store(true, std::memory_order_release);
+            for (auto &p : m_processors) {
+                p->thread.join();
+            }
+            m_processors_done.store(true, std::memory_order_release);
+            m_sink_thread.join();
+        }
+
+        /**
+         * Add item to batch of its processing thread, called by network stage
+         * @param handle Handle selecting processing thread
+         * @param item Item
+         * @throws exception thrown by any stage
+         */
+        void submit(uint64_t handle, T &&item)
+        {
+            auto &p = *m_processors[handle % m_processors.size()];
+            if (!p.pending) {
+                p.pending = std::make_unique<Batch>();
+                p.pending->items.reserve(p.batch_size);
+            }
+
+            p.pending->items.push_back(std::move(item));
+            if (p.pending->items.size() >= p.batch_size && !push(p)) {
+                rethrow();
+            }
+        }
+
+        /**
+         * Hand over partially filled batches of idle processing threads, called by network stage once it
+         * has no more items at hand
+         * @throws exception thrown by any stage
+         */
+        void flush()
+        {
+            if (m_failed.load(std::memory_order_acquire)) {
+                rethrow();
+            }
+
+            for (auto &p : m_processors) {
+                if (p->pending && !p->pending->items.empty() && p->input.size() == 0) {
+                    push(*p);
+                }
+            }
+        }
+
+        /**
+         * Print depth and throughput of all queues, called by network stage
+         * @param s Output stream
+         */
+        void report(std::ostream &s) const
+        {
+            for (size_t i = 0; i < m_processors.size(); i++) {
+                const auto &p = *m_processors[i];
+                s << "Pipeline processor " << i << " input: ";
+                print_queue(s, p.input, p.input_stats);
+                s << " batch size: " << p.batch_size << ", output: ";
+                print_queue(s, p.output, p.output_stats);
+                s << std::endl;
+            }
+        }
+
+    private:
+        /**
+         * Hand pending batch over to processing thread, waiting while its queue is full, and adapt batch size
+         * @param p Processing thread
+         * @return false if batch was not handed over because a stage failed
+         */
+        bool push(Processor &p)
+        {
+            auto items = p.pending->items.size();
+            while (!p.input.try_push(p.pending)) {
+                p.input_stats.stalls.fetch_add(1, std::memory_order_relaxed);
+                if (m_failed.load(std::memory_order_acquire)) {
+                    return false;
+                }
+                std::this_thread::yield();
+            }
+
+            // Grow batches while processing thread falls behind, shrink them while it keeps up
+            auto depth = p.input.size();
+            record(p.input_stats, items, depth);
+            if (depth > QUEUE_CAPACITY / 4) {
+                p.batch_size = std::min(p.batch_size * 2, MAX_BATCH_SIZE);
+            }
+            else if (depth <= 1) {
+                p.batch_size = std::max(p.batch_size / 2, MIN_BATCH_SIZE);
+            }
+
+            return true;
+        }
+
+        void run_processor(size_t index)
+        {
+            auto &p = *m_processors[index];
+            std::unique_ptr<Batch> batch;
+
+            try {
+                while (!m_failed.load(std::memory_order_acquire)) {
+                    if (!p.input.try_pop(batch)) {
+                        // Nothing is pushed after stop was requested
+                        if (m_stopping.load(std::memory_order_acquire) && p.input.size() == 0) {
+                            return;
+                        }
+                        std::this_thread::sleep_for(IDLE_SLEEP);
+                        continue;
+                    }
+
+                    for (auto &item : batch->items) {
+                        m_process(index, item);
+                    }
+
+                    auto items = batch->items.size();
+                    while (!p.output.try_push(batch)) {
+                        p.output_stats.stalls.fetch_add(1, std::memory_order_relaxed);
+                        if (m_failed.load(std::memory_order_acquire)) {
+                            return;
+                        }
+                        std::this_thread::yield();
+                    }
+                    record(p.output_stats, items, p.output.size());
+                }
+            }
+            catch (...) {
+                fail(std::current_exception());
+            }
+        }
+
+        void run_sink()
+        {
+            std::unique_ptr<Batch> batch;
+
+            try {
+                while (!m_failed.load(std::memory_order_acquire)) {
+                    // Nothing is pushed after all processing threads stopped
+                    auto done = m_processors_done.load(std::memory_order_acquire);
+
+                    // Take one batch from every processing thread in turn
+                    bool idle = true;
+                    for (auto &p : m_processors) {
+                        if (p->output.try_pop(batch)) {
+                            for (auto &item : batch->items) {
+                                m_sink(item);
+                            }
+                            idle = false;
+                        }
+                    }
+
+                    if (m_idle) {
+                        m_idle();
+                    }
+
+                    if (idle) {
+                        if (done) {
+                            return;
+                        }
+                        std::this_thread::sleep_for(IDLE_SLEEP);
+                    }
+                }
+            }
+            catch (...) {
+                fail(std::current_exception());
+            }
+        }
+
+        void fail(std::exception_ptr error)
+        {
+            if (!m_failed.exchange(true)) {
+                m_error = error;
+            }
+        }
+
+        /**
+         * Stop all threads and rethrow exception of failed stage
+         */
+        void rethrow()
+        {
+            stop();
+            std::rethrow_exception(m_error);
+        }
+
+        static void record(QueueStats &stats, size_t items, size_t depth)
+        {
+            stats.batches.fetch_add(1, std::memory_order_relaxed);
+            stats.items.fetch_add(items, std::memory_order_relaxed);
+            if (depth > stats.max_depth.load(std::memory_order_relaxed)) {
+                stats.max_depth.store(depth, std::memory_order_relaxed);
+            }
+        }
+
+        static void print_queue(std::ostream &s, const BatchQueue &queue, const QueueStats &stats)
+        {
+            auto batches = stats.batches.load(std::memory_order_relaxed);
+            auto items = stats.items.load(std::memory_order_relaxed);
+            s << "depth: " << queue.size() << " max: " << stats.max_depth.load(std::memory_order_relaxed)
+              << " batches: " << batches << " items: " << items << " mean batch: "
+              << (batches > 0 ? items / batches : 0) << " stalls: " << stats.stalls.load(std::memory_order_relaxed);
+        }
+
+    };
+
+}
@@ -0,0 +1,516 @@
+/**
+ * Author: Matej Postolka <matej@postolka.net>
+ * License: BSD 3-clause
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <tuple>
+#include <type_traits>
+
+#include "Device.h"
+#include "NetworkTools.h"
+
+namespace EHW {
+
+    /**
+     * Compile-time description of the wire format
+     *
+     * A frame layout is a list of field descriptors, each mapping part of the frame onto a member of a plain
+     * message struct. Encoders, decoders and size bounds of the layout are generated from the list, so both
+     * sides of the protocol share a single description of it. Fixed-size fields at the start of the frame
+     * are decoded at constant offsets after a single bounds check, the remaining fields sequentially.
+     */
+    namespace Protocol {
+
+        /**
+         * Result of attempt to decode a frame
+         */
+        enum class Status {
+            COMPLETE,
+            INCOMPLETE,
+            INVALID
+        };
+
+        /**
+         * Bytes of a variable-length field, pointing into the decoded buffer or the data to be encoded
+         */
+        struct Span {
+            const uint8_t *data;
+            uint32_t length;
+        };
+
+        /**
+         * Decoding position within a buffer
+         */
+        struct Reader {
+            const uint8_t *begin;
+            const uint8_t *pos;
+            const uint8_t *end;
+            // Largest acceptable frame size
+            size_t limit;
+
+            /**
+             * Check whether next bytes are available and within frame size limit
+             * @param len Number of bytes
+             * @return COMPLETE if available, INCOMPLETE if more data is needed, INVALID if over limit
+             */
+            [[nodiscard]]
+            Status need(size_t len) const
+            {
+                if (len > limit - static_cast<size_t>(pos - begin)) {
+                    return Status::INVALID;
+                }
+
+                return static_cast<size_t>(end - pos) < len ? Status::INCOMPLETE : Status::COMPLETE;
+            }
+        };
+
+        template<typename T>
+        inline T load(const uint8_t *src)
+        {
+            T val_nbo;
+            std::memcpy(&val_nbo, src, sizeof val_nbo);
+
+            return NetworkTools::endian_swap(val_nbo);
+        }
+
+        template<typename T>
+        inline uint8_t *store(uint8_t *dest, T val)
+        {
+            auto val_nbo = NetworkTools::endian_swap(val);
+            std::memcpy(dest, &val_nbo, sizeof val_nbo);
+
+            return dest + sizeof val_nbo;
+        }
+
+        template<typename>
+        struct MemberType;
+
+        template<typename C, typename T>
+        struct MemberType<T C::*> {
+            using type = T;
+        };
+
+        /**
+         * Common part of fields of constant size, which provide decode_fixed() reading from known position
+         * @tparam Field Field descriptor
+         * @tparam Size Size of field in bytes
+         */
+        template<typename Field, size_t Size>
+        struct FixedField {
+            static constexpr bool FIXED = true;
+            static constexpr size_t MAX_SIZE = Size;
+
+            template<typename M>
+            static constexpr size_t size(const M &)
+            { return Size; }
+
+            template<typename M>
+            static Status decode(Reader &reader, M &msg)
+            {
+                auto status = reader.need(Size);
+                if (status != Status::COMPLETE) {
+                    return status;
+                }
+
+                status = Field::decode_fixed(reader.pos, msg);
+                reader.pos += Size;
+
+                return status;
+            }
+        };
+
+        /**
+         * Magic sequence marking start of frame
+         */
+        struct Magic : FixedField<Magic, sizeof Device::PROTO_MAGIC> {
+            template<typename M>
+            static uint8_t *encode(uint8_t *dest, const M &)
+            {
+                std::memcpy(dest, Device::PROTO_MAGIC, sizeof Device::PROTO_MAGIC);
+
+                return dest + sizeof Device::PROTO_MAGIC;
+            }
+
+            template<typename M>
+            static Status decode_fixed(const uint8_t *src, M &)
+            {
+                return std::memcmp(src, Device::PROTO_MAGIC, sizeof Device::PROTO_MAGIC) == 0 ? Status::COMPLETE
+                                                                                               : Status::INVALID;
+            }
+        };
+
+        /**
+         * Integer in network byte order
+         * @tparam Member Pointer to integer member of message
+         * @tparam Validate Optional function rejecting invalid values
+         */
+        template<auto Member, auto Validate = nullptr>
+        struct Int : FixedField<Int<Member, Validate>, sizeof(typename MemberType<decltype(Member)>::type)> {
+            using Type = typename MemberType<decltype(Member)>::type;
+
+            template<typename M>
+            static uint8_t *encode(uint8_t *dest, const M &msg)
+            { return store(dest, msg.*Member); }
+
+            template<typename M>
+            static Status decode_fixed(const uint8_t *src, M &msg)
+            {
+                auto value = load<Type>(src);
+                if constexpr (!std::is_same_v<decltype(Validate), std::nullptr_t>) {
+                    if (!Validate(value)) {
+                        return Status::INVALID;
+                    }
+                }
+                msg.*Member = value;
+
+                return Status::COMPLETE;
+            }
+        };
+
+        /**
+         * IEEE 754 double precision number, transferred as 64-bit integer in network byte order
+         * @tparam Member Pointer to double member of message
+         */
+        template<auto Member>
+        struct Float : FixedField<Float<Member>, sizeof(uint64_t)> {
+            template<typename M>
+            static uint8_t *encode(uint8_t *dest, const M &msg)
+            {
+                uint64_t bits;
+                std::memcpy(&bits, &(msg.*Member), sizeof bits);
+
+                return store(dest, bits);
+            }
+
+            template<typename M>
+            static Status decode_fixed(const uint8_t *src, M &msg)
+            {
+                auto bits = load<uint64_t>(src);
+                std::memcpy(&(msg.*Member), &bits, sizeof bits);
+
+                return Status::COMPLETE;
+            }
+        };
+
+        /**
+         * 32-bit length of variable-length field, followed by the field itself later in layout
+         * @tparam Member Pointer to Span member of message
+         * @tparam MinLength Shortest accepted length
+         * @tparam MaxLength Longest accepted length
+         */
+        template<auto Member, uint32_t MinLength, uint32_t MaxLength>
+        struct Length : FixedField<Length<Member, MinLength, MaxLength>, sizeof(uint32_t)> {
+            static constexpr uint32_t MAX_LENGTH = MaxLength;
+
+            template<typename M>
+            static uint8_t *encode(uint8_t *dest, const M &msg)
+            { return store(dest, (msg.*Member).length); }
+
+            template<typename M>
+            static Status decode_fixed(const uint8_t *src, M &msg)
+            {
+                auto length = load<uint32_t>(src);
+                if (length < MinLength || length > MaxLength) {
+                    return Status::INVALID;
+                }
+                (msg.*Member).length = length;
+
+                return Status::COMPLETE;
+            }
+        };
+
+        /**
+         * Bytes of variable-length field whose length was decoded before
+         * @tparam LengthField Length descriptor of the field
+         * @tparam Member Pointer to Span member of message
+         */
+        template<typename LengthField, auto Member>
+        struct Payload {
+            static constexpr bool FIXED = false;
+            static constexpr size_t MAX_SIZE = LengthField::MAX_LENGTH;
+
+            template<typename M>
+            static size_t size(const M &msg)
+            { return (msg.*Member).length; }
+
+            template<typename M>
+            static uint8_t *encode(uint8_t *dest, const M &msg)
+            {
+                const auto &span = msg.*Member;
+                std::memcpy(dest, span.data, span.length);
+
+                return dest + span.length;
+            }
+
+            template<typename M>
+            static Status decode(Reader &reader, M &msg)
+            {
+                auto &span = msg.*Member;
+                auto status = reader.need(span.length);
+                if (status != Status::COMPLETE) {
+                    return status;
+                }
+
+                span.data = reader.pos;
+                reader.pos += span.length;
+
+                return Status::COMPLETE;
+            }
+        };
+
+        /**
+         * Field present only when flag is set in flags decoded before
+         * @tparam FlagsMember Pointer to member holding flags
+         * @tparam Flag Flag bit
+         * @tparam Field Descriptor of the field
+         */
+        template<auto FlagsMember, uint32_t Flag, typename Field>
+        struct Optional {
+            static constexpr bool FIXED = false;
+            static constexpr size_t MAX_SIZE = Field::MAX_SIZE;
+
+            template<typename M>
+            static size_t size(const M &msg)
+            { return (msg.*FlagsMember & Flag) ? Field::size(msg) : 0; }
+
+            template<typename M>
+            static uint8_t *encode(uint8_t *dest, const M &msg)
+            { return (msg.*FlagsMember & Flag) ? Field::encode(dest, msg) : dest; }
+
+            template<typename M>
+            static Status decode(Reader &reader, M &msg)
+            { return (msg.*FlagsMember & Flag) ? Field::decode(reader, msg) : Status::COMPLETE; }
+        };
+
+        /**
+         * Frame layout composed of field descriptors in wire order
+         * @tparam Fields Field descriptors
+         */
+        template<typename... Fields>
+        class Layout final {
+
+        private:
+            using FieldList = std::tuple<Fields...>;
+
+            static constexpr size_t FIELD_COUNT = sizeof...(Fields);
+
+            static constexpr size_t count_fixed()
+            {
+                constexpr bool fixed[] = {Fields::FIXED...};
+                size_t count = 0;
+                while (count < FIELD_COUNT && fixed[count]) {
+                    count++;
+                }
+
+                return count;
+            }
+
+            static constexpr size_t sum_sizes(size_t count)
+            {
+                constexpr size_t sizes[] = {Fields::MAX_SIZE...};
+                size_t sum = 0;
+                for (size_t i = 0; i < count; i++) {
+                    sum += sizes[i];
+                }
+
+                return sum;
+            }
+
+        public:
+            // Number of leading fields of constant size
+            static constexpr size_t FIXED_COUNT = count_fixed();
+            // Size of leading fields of constant size, which are decoded at constant offsets
+            static constexpr size_t FIXED_SIZE = sum_sizes(FIXED_COUNT);
+            // Size of largest possible frame
+            static constexpr size_t MAX_SIZE = sum_sizes(FIELD_COUNT);
+
+            /**
+             * Compute encoded size of message
+             * @param msg Message
+             * @return Size in bytes
+             */
+            template<typename M>
+            static size_t size(const M &msg)
+            { return (Fields::size(msg) + ...); }
+
+            /**
+             * Encode message
+             * @param dest Destination with room for size(msg) bytes
+             * @param msg Message
+             * @return Pointer past encoded frame
+             */
+            template<typename M>
+            static uint8_t *encode(uint8_t *dest, const M &msg)
+            {
+                ((dest = Fields::encode(dest, msg)), ...);
+
+                return dest;
+            }
+
+            /**
+             * Decode frame at start of buffer, variable-length fields of message point into the buffer
+             * @param pos Start of frame, advanced past the frame if complete
+             * @param end End of buffer
+             * @param msg Destination message
+             * @param limit Largest acceptable frame size, at least FIXED_SIZE
+             * @return COMPLETE if frame was decoded, INCOMPLETE if more data is needed, INVALID if the frame is
+             * corrupted or larger than limit
+             */
+            template<typename M>
+            static Status decode(const uint8_t *&pos, const uint8_t *end, M &msg, size_t limit = MAX_SIZE)
+            {
+                Reader reader{pos, pos, end, limit};
+
+                // Decode leading fields at constant offsets with single bounds check
+                Status status;
+                if (static_cast<size_t>(end - pos) >= FIXED_SIZE) {
+                    status = decode_fixed<0, 0>(pos, msg);
+                    reader.pos += FIXED_SIZE;
+                    if (status == Status::COMPLETE) {
+                        status = decode_from<FIXED_COUNT>(reader, msg);
+                    }
+                }
+                else {
+                    status = decode_from<0>(reader, msg);
+                }
+
+                if (status == Status::COMPLETE) {
+                    pos = reader.pos;
+                }
+
+                return status;
+            }
+
+        private:
+            template<size_t I, size_t Offset, typename M>
+            static Status decode_fixed(const uint8_t *src, M &msg)
+            {
+                if constexpr (I < FIXED_COUNT) {
+                    using Field = std::tuple_element_t<I, FieldList>;
+                    auto status = Field::decode_fixed(src + Offset, msg);
+                    if (status != Status::COMPLETE) {
+                        return status;
+                    }
+
+                    return decode_fixed<I + 1, Offset + Field::MAX_SIZE>(src, msg);
+                }
+                else {
+                    return Status::COMPLETE;
+                }
+            }
+
+            template<size_t I, typename M>
+            static Status decode_from(Reader &reader, M &msg)
+            {
+                if constexpr (I < FIELD_COUNT) {
+                    auto status = std::tuple_element_t<I, FieldList>::decode(reader, msg);
+                    if (status != Status::COMPLETE) {
+                        return status;
+                    }
+
+                    return decode_from<I + 1>(reader, msg);
+                }
+                else {
+                    return Status::COMPLETE;
+                }
+            }
+
+        };
+
+        // Longest device identifier
+        static constexpr uint32_t MAX_ID_LENGTH = 1024;
+        // Longest device data
+        static constexpr uint32_t MAX_DATA_LENGTH = 65536;
+
+        /**
+         * Contents of data frame sent by devices
+         */
+        struct Frame {
+            // Device type in low bits, frame flags in high bits
+            uint32_t type;
+            Span id;
+            Span data;
+            // Send time in nanoseconds since epoch, present with FLAG_SEND_TIMESTAMP
+            uint64_t send_time;
+            // Per-device sequence number, present with FLAG_SEQUENCE
+            uint32_t sequence;
+        };
+
+        /**
+         * Check that type field holds known device type and known flags only
+         * @param type Type field
+         * @return true if valid
+         */
+        constexpr bool valid_type(uint32_t type)
+        {
+            return (type & Device::TYPE_MASK) < Device::TYPE_COUNT &&
+                   (type & ~Device::TYPE_MASK & ~Device::KNOWN_FLAGS) == 0;
+        }
+
+        using IdLength = Length<&Frame::id, 1, MAX_ID_LENGTH>;
+        using DataLength = Length<&Frame::data, 0, MAX_DATA_LENGTH>;
+
+        // Wire layout of data frame
+        using FrameLayout = Layout<
+                Magic,
+                Int<&Frame::type, valid_type>,
+                IdLength,
+                Payload<IdLength, &Frame::id>,
+                DataLength,
+                Payload<DataLength, &Frame::data>,
+                Optional<&Frame::type, Device::FLAG_SEND_TIMESTAMP, Int<&Frame::send_time>>,
+                Optional<&Frame::type, Device::FLAG_SEQUENCE, Int<&Frame::sequence>>>;
+
+        // Size of data frame without identifier and data
+        static constexpr size_t FRAME_OVERHEAD = FrameLayout::MAX_SIZE - MAX_ID_LENGTH - MAX_DATA_LENGTH;
+
+        static_assert(FrameLayout::FIXED_SIZE == 12, "magic, type and identifier length are at fixed offsets");
+
+        /**
+         * Readings of single device aggregated by relay server, carried as data of frame with FLAG_SUMMARY
+         */
+        struct Summary {
+            // Number of aggregated readings
+            uint64_t messages;
+            // Number of aggregated readings with numeric value, over which min, max and sum are computed
+            uint64_t values;
+            double min;
+            double max;
+            double sum;
+            // Receive times of first and last aggregated reading in nanoseconds since epoch
+            uint64_t first_time;
+            uint64_t last_time;
+        };
+
+        // Wire layout of summary
+        using SummaryLayout = Layout<
+                Int<&Summary::messages>,
+                Int<&Summary::values>,
+                Float<&Summary::min>,
+                Float<&Summary::max>,
+                Float<&Summary::sum>,
+                Int<&Summary::first_time>,
+                Int<&Summary::last_time>>;
+
+        /**
+         * Decode summary carried as data of frame
+         * @param data Data of frame
+         * @param summary Destination summary
+         * @return true if data holds exactly one summary
+         */
+        inline bool decode_summary(const Span &data, Summary &summary)
+        {
+            auto pos = data.data;
+            auto end = pos + data.length;
+
+            return SummaryLayout::decode(pos, end, summary) == Status::COMPLETE && pos == end;
+        }
+
+    }
+
+}
@@ -0,0 +1,337 @@
+/**
+ * Author: Matej Postolka <matej@postolka.net>
+ * License: BSD 3-clause
+ */
+
+#include <stdexcept>
+#include <algorithm>
+#include <cerrno>
+
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <arpa/inet.h>
+
+#include "Publisher.h"
+#include "Server.h"
+#include "NetworkTools.h"
+
+EHW::Publisher::Publisher(uint16_t port, size_t queue_depth, DropPolicy drop_policy) : m_port{port},
+                                                                                       m_queue_depth{queue_depth},
+                                                                                       m_drop_policy{drop_policy},
+                                                                                       m_socket{-1},
+                                                                                       m_socket_initialized{false},
+                                                                                       m_pending{std::make_unique<Batch>()},
+                                                                                       m_total_dropped{0}
+{
+}
+
+EHW::Publisher::~Publisher()
+{
+    close();
+}
+
+void EHW::Publisher::setup_socket()
+{
+    ::sockaddr_in server_addr{};
+    server_addr.sin_family = AF_INET;
+    server_addr.sin_addr.s_addr = INADDR_ANY;
+    server_addr.sin_port = NetworkTools::endian_swap(m_port);
+
+    if ((m_socket = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0)) < 0) {
+        throw std::runtime_error("cannot create subscriber socket");
+    }
+
+    int opt = 1;
+    if (::setsockopt(m_socket, SOL_SOCKET, SO_REUSEADDR | SO_REUSEPORT, &opt, sizeof opt) != 0) {
+        ::close(m_socket);
+        throw std::runtime_error("setsockopt() failed");
+    }
+
+    if (::bind(m_socket, (struct sockaddr *) &server_addr, sizeof server_addr) < 0) {
+        ::close(m_socket);
+        throw std::runtime_error("bind() failed");
+    }
+
+    if (::listen(m_socket, SOCKET_BACKLOG) < 0) {
+        ::close(m_socket);
+        throw std::runtime_error("listen() failed");
+    }
+
+    m_socket_initialized = true;
+}
+
+void EHW::Publisher::close()
+{
+    if (!m_socket_initialized)
+        return;
+
+    m_socket_initialized = false;
+
+    // Close listening socket
+    ::close(m_socket);
+
+    // Close all subscriber connections
+    for (auto &item : m_subscribers) {
+        ::close(item.first);
+    }
+    m_subscribers.clear();
+}
+
+void EHW::Publisher::publish(const DataPack &pack)
+{
+    // Nobody would receive the reading
+    if (m_subscribers.empty()) {
+        return;
+    }
+
+    auto offset = m_pending->data.size();
+
+    // Render reading once for all subscribers
+    auto device_id = pack.get_id();
+    m_pending->data.append(device_id);
+    m_pending->data.push_back(' ');
+    m_pending->data.append(std::to_string(static_cast<int>(pack.get_type())));
+    m_pending->data.push_back(' ');
+    m_pending->data.append(pack.get_data());
+    m_pending->data.push_back(' ');
+    m_pending->data.append(std::to_string(pack.get_timestamp()));
+    m_pending->data.push_back('\n');
+
+    m_pending->entries.push_back({std::move(device_id), pack.get_type(), offset, m_pending->data.size() - offset});
+}
+
+void EHW::Publisher::handle_subscribers()
+{
+    if (!m_socket_initialized) {
+        throw std::runtime_error("cannot handle subscribers with uninitialized socket");
+    }
+
+    fan_out();
+
+    // Check for new subscribers
+    auto server_pollfd = ::pollfd{};
+    server_pollfd.fd = m_socket;
+    server_pollfd.events = POLLIN;
+    if (::poll(&server_pollfd, 1, 0) > 0 && (server_pollfd.revents & POLLIN)) {
+        accept_subscriber();
+    }
+
+    if (m_subscribers.empty()) {
+        return;
+    }
+
+    // Poll subscribers for commands, and for writability if they have pending data
+    m_poll_set.clear();
+    for (auto &item : m_subscribers) {
+        auto sub_pollfd = ::pollfd{};
+        sub_pollfd.fd = item.first;
+        sub_pollfd.events = POLLIN;
+        if (!item.second.queue.empty()) {
+            sub_pollfd.events |= POLLOUT;
+        }
+        m_poll_set.push_back(sub_pollfd);
+    }
+
+    if (::poll(m_poll_set.data(), m_poll_set.size(), 0) <= 0) {
+        return;
+    }
+
+    for (auto &pfd : m_poll_set) {
+        auto &sub = m_subscribers.at(pfd.fd);
+
+        bool alive = true;
+        if (pfd.revents & (POLLIN | POLLHUP | POLLERR)) {
+            alive = read_commands(sub);
+        }
+        if (alive && (pfd.revents & POLLOUT)) {
+            alive = write_queue(sub);
+        }
+
+        if (!alive) {
+            close_subscriber(pfd.fd);
+        }
+    }
+}
+
+void EHW::Publisher::fan_out()
+{
+    if (m_pending->entries.empty()) {
+        return;
+    }
+
+    // Pending batch becomes immutable and shared from now on
+    std::shared_ptr<const Batch> batch = std::move(m_pending);
+    m_pending = std::make_unique<Batch>();
+
+    for (auto &item : m_subscribers) {
+        auto &sub = item.second;
+
+        for (auto &entry : batch->entries) {
+            if (!matches(sub, entry)) {
+                continue;
+            }
+
+            if (sub.queue.size() >= m_queue_depth) {
+                sub.dropped++;
+                m_total_dropped++;
+
+                // Partially written reading must be finished to keep stream consistent
+                if (m_drop_policy == DropPolicy::DROP_NEWEST || (sub.queue.size() == 1 && sub.front_written > 0)) {
+                    continue;
+                }
+
+                // Keep partially written front, drop the oldest untouched reading
+                if (sub.front_written > 0) {
+                    sub.queue.erase(sub.queue.begin() + 1);
+                }
+                else {
+                    sub.queue.pop_front();
+                }
+            }
+
+            sub.queue.push_back({batch, batch->data.data() + entry.offset, entry.length});
+        }
+    }
+}
+
+void EHW::Publisher::accept_subscriber()
+{
+    int new_socket;
+    if ((new_socket = ::accept4(m_socket, nullptr, nullptr, SOCK_NONBLOCK)) < 0) {
+        return;
+    }
+
+    auto &sub = m_subscribers[new_socket];
+    sub.fd = new_socket;
+    sub.all = false;
+    sub.types = 0;
+    sub.front_written = 0;
+    sub.dropped = 0;
+}
+
+bool EHW::Publisher::read_commands(Subscriber &sub)
+{
+    char buffer[MAX_COMMAND_LENGTH];
+    auto len = ::read(sub.fd, buffer, sizeof buffer);
+    if (len < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+        return true;
+    }
+    if (len <= 0) {
+        return false;
+    }
+    sub.rx_buffer.append(buffer, len);
+
+    size_t line_end;
+    while ((line_end = sub.rx_buffer.find('\n')) != std::string::npos) {
+        auto line = sub.rx_buffer.substr(0, line_end);
+        sub.rx_buffer.erase(0, line_end + 1);
+
+        if (!line.empty() && line.back() == '\r') {
+            line.pop_back();
+        }
+
+        auto space = line.find(' ');
+        auto command = line.substr(0, space);
+        auto argument = space == std::string::npos ? std::string{} : line.substr(space + 1);
+
+        if (command == "all") {
+            sub.all = true;
+        }
+        else if (command == "id" && !argument.empty()) {
+            sub.ids.insert(argument);
+        }
+        else if (command == "prefix" && !argument.empty()) {
+            sub.prefixes.push_back(argument);
+        }
+        else if (command == "type") {
+            auto it = Device::TYPE_STRINGS.find(argument);
+            if (it == Device::TYPE_STRINGS.end()) {
+                return false;
+            }
+            sub.types |= 1u << static_cast<uint32_t>(it->second);
+        }
+        else {
+            return false;
+        }
+    }
+
+    return sub.rx_buffer.size() < MAX_COMMAND_LENGTH;
+}
+
+bool EHW::Publisher::write_queue(Subscriber &sub)
+{
+    while (!sub.queue.empty()) {
+        // Gather queued readings, merging neighbours from the same batch
+        ::iovec iov[MAX_IOV];
+        size_t iov_count = 0;
+        for (auto it = sub.queue.begin(); it != sub.queue.end(); it++) {
+            auto data = it->data;
+            auto length = it->length;
+            if (it == sub.queue.begin()) {
+                data += sub.front_written;
+                length -= sub.front_written;
+            }
+
+            if (iov_count > 0 && static_cast<char *>(iov[iov_count - 1].iov_base) + iov[iov_count - 1].iov_len == data) {
+                iov[iov_count - 1].iov_len += length;
+                continue;
+            }
+            if (iov_count == MAX_IOV) {
+                break;
+            }
+            iov[iov_count].iov_base = const_cast<char *>(data);
+            iov[iov_count].iov_len = length;
+            iov_count++;
+        }
+
+        ::msghdr msg{};
+        msg.msg_iov = iov;
+        msg.msg_iovlen = iov_count;
+        auto sent = ::sendmsg(sub.fd, &msg, MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (sent < 0) {
+            return errno == EAGAIN || errno == EWOULDBLOCK;
+        }
+
+        // Release fully written readings
+        size_t remaining = sent;
+        while (remaining > 0 && !sub.queue.empty()) {
+            auto left = sub.queue.front().length - sub.front_written;
+            if (remaining < left) {
+                sub.front_written += remaining;
+                return true;
+            }
+            remaining -= left;
+            sub.front_written = 0;
+            sub.queue.pop_front();
+        }
+    }
+
+    return true;
+}
+
+bool EHW::Publisher::matches(const Subscriber &sub, const Batch::Entry &entry)
+{
+    if (sub.all) {
+        return true;
+    }
+
+    auto type = static_cast<uint32_t>(entry.device_type);
+    if (type < 32 && (sub.types & (1u << type))) {
+        return true;
+    }
+
+    if (sub.ids.count(entry.device_id)) {
+        return true;
+    }
+
+    return std::any_of(sub.prefixes.begin(), sub.prefixes.end(), [&entry](const std::string &prefix) {
+        return entry.device_id.compare(0, prefix.size(), prefix) == 0;
+    });
+}
+
+void EHW::Publisher::close_subscriber(int fd)
+{
+    ::close(fd);
+    m_subscribers.erase(fd);
+}
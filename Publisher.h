@@ -0,0 +1,174 @@
+/**
+ * Author: Matej Postolka <matej@postolka.net>
+ * License: BSD 3-clause
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <string>
+#include <deque>
+#include <map>
+#include <set>
+#include <memory>
+
+#include <poll.h>
+
+#include "Device.h"
+
+namespace EHW {
+
+    class DataPack;
+
+    /**
+     * Fans out received data packs to subscribers connected on a dedicated port
+     *
+     * Subscribers send newline-terminated commands to select readings:
+     *  - `id DEVICE-ID` subscribes to a single device
+     *  - `prefix PREFIX` subscribes to all devices with ID starting with PREFIX
+     *  - `type DEVICE-TYPE` subscribes to all devices of given type
+     *  - `all` subscribes to all devices
+     *
+     * Readings are published in batches. Each batch is rendered once into an immutable buffer shared by all
+     * subscribers, whose queues only hold references into it. Queues are bounded and never block ingestion,
+     * readings that do not fit are dropped according to the drop policy.
+     */
+    class Publisher final {
+
+    public:
+        // Behaviour of full subscriber queue
+        enum class DropPolicy {
+            // Discard queued readings to make room for new ones
+            DROP_OLDEST,
+            // Discard new readings until queue drains
+            DROP_NEWEST
+        };
+
+        // Default number of readings queued per subscriber
+        static constexpr size_t DEFAULT_QUEUE_DEPTH = 4096;
+
+    private:
+        static constexpr int SOCKET_BACKLOG = 32;
+        // Maximum length of subscription command
+        static constexpr size_t MAX_COMMAND_LENGTH = 1024;
+        // Maximum number of buffers passed to single writev() call
+        static constexpr size_t MAX_IOV = 64;
+
+        /**
+         * Immutable set of readings rendered once and shared by all subscribers
+         */
+        struct Batch {
+            struct Entry {
+                std::string device_id;
+                Device::Type device_type;
+                size_t offset;
+                size_t length;
+            };
+
+            std::string data;
+            std::vector<Entry> entries;
+        };
+
+        /**
+         * Reference to single reading inside shared batch
+         */
+        struct QueueEntry {
+            std::shared_ptr<const Batch> batch;
+            const char *data;
+            size_t length;
+        };
+
+        struct Subscriber {
+            int fd;
+            std::string rx_buffer;
+
+            // Subscription filters
+            bool all;
+            uint32_t types;
+            std::set<std::string> ids;
+            std::vector<std::string> prefixes;
+
+            std::deque<QueueEntry> queue;
+            // Bytes of queue front already written to socket
+            size_t front_written;
+            uint64_t dropped;
+        };
+
+        const uint16_t m_port;
+        const size_t m_queue_depth;
+        const DropPolicy m_drop_policy;
+
+        int m_socket;
+        bool m_socket_initialized;
+
+        // Batch being filled by current event loop iteration
+        std::unique_ptr<Batch> m_pending;
+        std::map<int, Subscriber> m_subscribers;
+        std::vector<::pollfd> m_poll_set;
+
+        uint64_t m_total_dropped;
+
+    public:
+        explicit Publisher(uint16_t port, size_t queue_depth, DropPolicy drop_policy);
+
+        ~Publisher();
+
+        /**
+         * Setup listening socket for subscribers
+         * @throws std::runtime_error
+         */
+        void setup_socket();
+
+        /**
+         * Close listening socket and all subscriber connections
+         */
+        void close();
+
+        /**
+         * Add data pack to current batch
+         * @param pack Data pack
+         */
+        void publish(const DataPack &pack);
+
+        /**
+         * Fan out current batch, accept new subscribers, process subscription commands and write queued data
+         * without blocking
+         */
+        void handle_subscribers();
+
+        /**
+         * Get total number of readings dropped due to full subscriber queues
+         * @return Number of dropped readings
+         */
+        [[nodiscard]]
+        inline uint64_t get_dropped() const
+        { return m_total_dropped; }
+
+    private:
+        /**
+         * Seal pending batch and enqueue its readings to matching subscribers
+         */
+        void fan_out();
+
+        void accept_subscriber();
+
+        /**
+         * Read and apply subscription commands
+         * @return false if subscriber disconnected or misbehaved
+         */
+        static bool read_commands(Subscriber &sub);
+
+        /**
+         * Write as much of queued data as socket accepts
+         * @return false if subscriber disconnected
+         */
+        static bool write_queue(Subscriber &sub);
+
+        static bool matches(const Subscriber &sub, const Batch::Entry &entry);
+
+        void close_subscriber(int fd);
+
+    };
+
+}
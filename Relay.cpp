@@ -0,0 +1,318 @@
+/**
+ * Author: Matej Postolka <matej@postolka.net>
+ * License: BSD 3-clause
+ */
+
+#include <stdexcept>
+#include <string_view>
+#include <functional>
+#include <algorithm>
+#include <limits>
+#include <cstdlib>
+#include <cerrno>
+
+#include <unistd.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <arpa/inet.h>
+
+#include "Relay.h"
+#include "NetworkTools.h"
+
+EHW::Relay::Relay(const Config &config) : m_config{config},
+                                          m_address{},
+                                          m_upstreams(config.connections),
+                                          m_window_end{0},
+                                          m_forwarded{0},
+                                          m_dropped{0},
+                                          m_disconnects{0}
+{
+    if (config.connections == 0 || config.window == 0) {
+        throw std::runtime_error("relay needs at least one connection and window of at least one second");
+    }
+
+    m_address.sin_family = AF_INET;
+    m_address.sin_port = NetworkTools::endian_swap(config.port);
+    if (::inet_pton(AF_INET, config.host.c_str(), &m_address.sin_addr) != 1) {
+        throw std::runtime_error("invalid IPv4 address");
+    }
+
+    for (auto &up : m_upstreams) {
+        up.fd = -1;
+        up.connected = false;
+        up.tx_offset = 0;
+        up.retry_time = 0;
+    }
+}
+
+EHW::Relay::~Relay()
+{
+    for (auto &up : m_upstreams) {
+        if (up.fd >= 0) {
+            ::close(up.fd);
+        }
+    }
+}
+
+void EHW::Relay::forward_reading(const Protocol::Frame &frame, const uint8_t *encoded, size_t length, uint64_t now)
+{
+    if (m_config.raw) {
+        auto dest = reserve(m_upstreams[select_upstream(frame.id)], length);
+        if (dest) {
+            std::copy(encoded, encoded + length, dest);
+        }
+        return;
+    }
+
+    auto &summary = find_aggregate(frame).summary;
+    summary.messages++;
+    summary.first_time = std::min(summary.first_time, now);
+    summary.last_time = std::max(summary.last_time, now);
+
+    // Non-numeric values are only counted
+    auto data = std::string(reinterpret_cast<const char *>(frame.data.data), frame.data.length);
+    char *end;
+    auto value = std::strtod(data.c_str(), &end);
+    if (data.empty() || *end != '\0') {
+        return;
+    }
+
+    summary.values++;
+    summary.min = std::min(summary.min, value);
+    summary.max = std::max(summary.max, value);
+    summary.sum += value;
+}
+
+void EHW::Relay::forward_summary(const Protocol::Frame &frame, const Protocol::Summary &summary,
+                                 const uint8_t *encoded, size_t length)
+{
+    if (m_config.raw) {
+        auto dest = reserve(m_upstreams[select_upstream(frame.id)], length);
+        if (dest) {
+            std::copy(encoded, encoded + length, dest);
+        }
+        return;
+    }
+
+    auto &merged = find_aggregate(frame).summary;
+    merged.messages += summary.messages;
+    merged.values += summary.values;
+    merged.min = std::min(merged.min, summary.min);
+    merged.max = std::max(merged.max, summary.max);
+    merged.sum += summary.sum;
+    merged.first_time = std::min(merged.first_time, summary.first_time);
+    merged.last_time = std::max(merged.last_time, summary.last_time);
+}
+
+void EHW::Relay::poll(uint64_t now)
+{
+    if (now >= m_window_end) {
+        flush_aggregates();
+        m_window_end = now + static_cast<uint64_t>(m_config.window) * 1000000000;
+    }
+
+    for (auto &up : m_upstreams) {
+        if (up.fd < 0 && now >= up.retry_time) {
+            connect(up, now);
+        }
+        if (up.fd >= 0 && !up.connected) {
+            finish_connect(up, now);
+        }
+        if (up.connected) {
+            write(up, now);
+        }
+    }
+}
+
+void EHW::Relay::close()
+{
+    flush_aggregates();
+
+    for (auto &up : m_upstreams) {
+        // Wait for connection in progress and writable socket, do not reconnect
+        while (up.fd >= 0 && up.tx_offset < up.tx_buffer.size()) {
+            auto pfd = ::pollfd{};
+            pfd.fd = up.fd;
+            pfd.events = POLLOUT;
+            if (::poll(&pfd, 1, CLOSE_TIMEOUT) <= 0) {
+                break;
+            }
+
+            if (!up.connected) {
+                finish_connect(up, 0);
+            }
+            if (up.connected) {
+                write(up, 0);
+            }
+        }
+
+        if (up.fd >= 0) {
+            ::close(up.fd);
+            up.fd = -1;
+            up.connected = false;
+        }
+    }
+}
+
+void EHW::Relay::report(std::ostream &s) const
+{
+    size_t unsent = 0;
+    for (const auto &up : m_upstreams) {
+        unsent += up.tx_buffer.size() - up.tx_offset;
+    }
+
+    s << "Relay frames forwarded: " << m_forwarded << " dropped: " << m_dropped << " bytes unsent: " << unsent
+      << ", upstream connections lost: " << m_disconnects << std::endl;
+}
+
+EHW::Relay::Aggregate &EHW::Relay::find_aggregate(const Protocol::Frame &frame)
+{
+    auto id = std::string(reinterpret_cast<const char *>(frame.id.data), frame.id.length);
+    auto it = m_aggregates.find(id);
+    if (it == m_aggregates.end()) {
+        auto aggregate = Aggregate{};
+        aggregate.type = static_cast<Device::Type>(frame.type & Device::TYPE_MASK);
+        aggregate.summary.min = std::numeric_limits<double>::infinity();
+        aggregate.summary.max = -std::numeric_limits<double>::infinity();
+        aggregate.summary.first_time = std::numeric_limits<uint64_t>::max();
+        it = m_aggregates.emplace(std::move(id), aggregate).first;
+    }
+
+    return it->second;
+}
+
+void EHW::Relay::flush_aggregates()
+{
+    uint8_t data[Protocol::SummaryLayout::MAX_SIZE];
+
+    for (const auto &item : m_aggregates) {
+        Protocol::SummaryLayout::encode(data, item.second.summary);
+
+        auto frame = Protocol::Frame{};
+        frame.type = static_cast<uint32_t>(item.second.type) | Device::FLAG_SUMMARY;
+        frame.id = {reinterpret_cast<const uint8_t *>(item.first.data()), static_cast<uint32_t>(item.first.size())};
+        frame.data = {data, sizeof data};
+
+        auto dest = reserve(m_upstreams[select_upstream(frame.id)], Protocol::FrameLayout::size(frame));
+        if (dest) {
+            Protocol::FrameLayout::encode(dest, frame);
+        }
+    }
+
+    m_aggregates.clear();
+}
+
+size_t EHW::Relay::select_upstream(const Protocol::Span &id) const
+{
+    auto key = std::string_view(reinterpret_cast<const char *>(id.data), id.length);
+
+    return std::hash<std::string_view>{}(key) % m_upstreams.size();
+}
+
+uint8_t *EHW::Relay::reserve(Upstream &up, size_t length)
+{
+    if (length > MAX_BUFFERED - (up.tx_buffer.size() - up.tx_offset)) {
+        m_dropped++;
+        return nullptr;
+    }
+
+    auto size = up.tx_buffer.size();
+    up.tx_buffer.resize(size + length);
+    m_forwarded++;
+
+    return up.tx_buffer.data() + size;
+}
+
+void EHW::Relay::connect(Upstream &up, uint64_t now)
+{
+    if ((up.fd = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0)) < 0) {
+        throw std::runtime_error("cannot create socket");
+    }
+
+    if (::connect(up.fd, (struct sockaddr *) &m_address, sizeof m_address) == 0) {
+        up.connected = true;
+    }
+    else if (errno != EINPROGRESS) {
+        disconnect(up, now);
+    }
+}
+
+void EHW::Relay::finish_connect(Upstream &up, uint64_t now)
+{
+    auto pfd = ::pollfd{};
+    pfd.fd = up.fd;
+    pfd.events = POLLOUT;
+    if (::poll(&pfd, 1, 0) <= 0) {
+        return;
+    }
+
+    int error = 0;
+    auto len = static_cast<socklen_t>(sizeof error);
+    if (::getsockopt(up.fd, SOL_SOCKET, SO_ERROR, &error, &len) < 0 || error != 0) {
+        disconnect(up, now);
+        return;
+    }
+
+    up.connected = true;
+}
+
+void EHW::Relay::write(Upstream &up, uint64_t now)
+{
+    while (up.tx_offset < up.tx_buffer.size()) {
+        auto len = ::send(up.fd, up.tx_buffer.data() + up.tx_offset, up.tx_buffer.size() - up.tx_offset,
+                          MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (len < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                disconnect(up, now);
+            }
+            break;
+        }
+        up.tx_offset += len;
+    }
+
+    // Avoid moving buffered data on every write
+    if (up.tx_offset == up.tx_buffer.size()) {
+        up.tx_buffer.clear();
+        up.tx_offset = 0;
+    }
+    else if (up.tx_offset >= COMPACT_THRESHOLD && up.tx_offset >= up.tx_buffer.size() / 2) {
+        discard(up, up.tx_offset);
+    }
+}
+
+void EHW::Relay::disconnect(Upstream &up, uint64_t now)
+{
+    if (up.connected) {
+        m_disconnects++;
+    }
+
+    ::close(up.fd);
+    up.fd = -1;
+    up.connected = false;
+    up.retry_time = now + RECONNECT_DELAY;
+
+    // Frames sent before may or may not have been received, the partially sent one certainly was not
+    discard(up, up.tx_offset);
+    up.tx_offset = 0;
+}
+
+void EHW::Relay::discard(Upstream &up, size_t offset)
+{
+    // Buffer holds only complete frames encoded by relay, walk them to frame boundary
+    const uint8_t *begin = up.tx_buffer.data();
+    const uint8_t *pos = begin;
+    const uint8_t *end = begin + up.tx_buffer.size();
+    while (pos != end) {
+        auto next = pos;
+        Protocol::Frame frame{};
+        if (Protocol::FrameLayout::decode(next, end, frame) != Protocol::Status::COMPLETE ||
+            static_cast<size_t>(next - begin) > offset) {
+            break;
+        }
+        pos = next;
+    }
+
+    auto boundary = static_cast<size_t>(pos - begin);
+    up.tx_buffer.erase(up.tx_buffer.begin(), up.tx_buffer.begin() + boundary);
+    up.tx_offset -= boundary;
+}
@@ -0,0 +1,200 @@
+/**
+ * Author: Matej Postolka <matej@postolka.net>
+ * License: BSD 3-clause
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <ostream>
+
+#include <netinet/in.h>
+
+#include "Device.h"
+#include "Protocol.h"
+
+namespace EHW {
+
+    /**
+     * Forwards received frames to upstream server over a few persistent connections
+     *
+     * In summary mode, readings are aggregated per device over fixed time windows and every window is
+     * forwarded as one summary frame per device, holding message count and minimum, maximum and sum of
+     * numeric values. In raw mode, frames are forwarded unchanged. Summaries received from downstream relays
+     * are merged, respectively forwarded, the same way, so relays can be stacked.
+     *
+     * Every device is forwarded over the same connection to keep its frames in order. Frames are buffered
+     * while upstream is unreachable and connections are reestablished in the background, frames which do not
+     * fit into the bounded buffer are dropped.
+     */
+    class Relay final {
+
+    public:
+        struct Config {
+            // IPv4 address of upstream server
+            std::string host;
+            uint16_t port = 0;
+            // Number of persistent upstream connections
+            uint32_t connections = 1;
+            // Length of aggregation window in seconds
+            uint32_t window = 1;
+            // Forward frames unchanged instead of summaries
+            bool raw = false;
+        };
+
+    private:
+        // Most bytes buffered per upstream connection
+        static constexpr size_t MAX_BUFFERED = 16 * 1024 * 1024;
+        // Sent bytes are discarded from buffer once they exceed this size and half of the buffer
+        static constexpr size_t COMPACT_THRESHOLD = 64 * 1024;
+        // Delay before reconnecting lost upstream connection in nanoseconds
+        static constexpr uint64_t RECONNECT_DELAY = 1000000000;
+        // Time given to buffered frames to drain on close in milliseconds
+        static constexpr int CLOSE_TIMEOUT = 1000;
+
+        /**
+         * Readings of single device in current window
+         */
+        struct Aggregate {
+            Device::Type type;
+            Protocol::Summary summary;
+        };
+
+        struct Upstream {
+            // Socket, -1 while disconnected
+            int fd;
+            // Connection was established, otherwise still in progress
+            bool connected;
+            // Encoded frames, starting at frame boundary
+            std::vector<uint8_t> tx_buffer;
+            // Bytes of buffer already sent
+            size_t tx_offset;
+            // Earliest time of next connection attempt in nanoseconds since epoch
+            uint64_t retry_time;
+        };
+
+        const Config m_config;
+        ::sockaddr_in m_address;
+
+        std::vector<Upstream> m_upstreams;
+
+        std::unordered_map<std::string, Aggregate> m_aggregates;
+        // End of current window in nanoseconds since epoch, 0 before first poll
+        uint64_t m_window_end;
+
+        uint64_t m_forwarded;
+        uint64_t m_dropped;
+        uint64_t m_disconnects;
+
+    public:
+        /**
+         * Create relay, connections are established by poll()
+         * @param config Relay configuration
+         * @throws std::runtime_error on invalid address
+         */
+        explicit Relay(const Config &config);
+
+        ~Relay();
+
+        Relay(const Relay &) = delete;
+
+        Relay &operator=(const Relay &) = delete;
+
+        /**
+         * Forward single reading
+         * @param frame Decoded frame
+         * @param encoded Encoded frame
+         * @param length Length of encoded frame
+         * @param now Receive time in nanoseconds since epoch
+         */
+        void forward_reading(const Protocol::Frame &frame, const uint8_t *encoded, size_t length, uint64_t now);
+
+        /**
+         * Forward summary received from downstream relay
+         * @param frame Decoded frame
+         * @param summary Summary carried by frame
+         * @param encoded Encoded frame
+         * @param length Length of encoded frame
+         */
+        void forward_summary(const Protocol::Frame &frame, const Protocol::Summary &summary, const uint8_t *encoded,
+                             size_t length);
+
+        /**
+         * Flush ended window, (re)connect upstream and write buffered frames without blocking
+         * @param now Current time in nanoseconds since epoch
+         * @throws std::runtime_error
+         */
+        void poll(uint64_t now);
+
+        /**
+         * Flush current window and give buffered frames limited time to drain before closing connections
+         */
+        void close();
+
+        /**
+         * Print forwarding statistics
+         * @param s Output stream
+         */
+        void report(std::ostream &s) const;
+
+    private:
+        /**
+         * Find aggregate of device, creating empty one for new device
+         * @param frame Frame received from device
+         * @return Aggregate of device
+         */
+        Aggregate &find_aggregate(const Protocol::Frame &frame);
+
+        /**
+         * Encode summaries of all devices into upstream buffers and start new window
+         */
+        void flush_aggregates();
+
+        /**
+         * Select upstream connection of device
+         * @param id Device identifier
+         * @return Index of connection
+         */
+        [[nodiscard]]
+        size_t select_upstream(const Protocol::Span &id) const;
+
+        /**
+         * Reserve room for frame in upstream buffer
+         * @param up Upstream connection
+         * @param length Length of frame
+         * @return Destination of frame, nullptr if frame was dropped
+         */
+        uint8_t *reserve(Upstream &up, size_t length);
+
+        void connect(Upstream &up, uint64_t now);
+
+        /**
+         * Check whether connection in progress was established
+         */
+        void finish_connect(Upstream &up, uint64_t now);
+
+        /**
+         * Write buffered frames until socket would block
+         */
+        void write(Upstream &up, uint64_t now);
+
+        /**
+         * Close connection and rewind buffer to start of partially sent frame, which is resent in full after
+         * reconnecting
+         */
+        void disconnect(Upstream &up, uint64_t now);
+
+        /**
+         * Discard sent frames from buffer
+         * @param up Upstream connection
+         * @param offset Bytes to discard, rounded down to frame boundary
+         */
+        static void discard(Upstream &up, size_t offset);
+
+    };
+
+}
@@ -0,0 +1,197 @@
+/**
+ * Author: Matej Postolka <matej@postolka.net>
+ * License: BSD 3-clause
+ */
+
+#include <stdexcept>
+#include <csignal>
+#include <iostream>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <map>
+#include <algorithm>
+
+#include <unistd.h>
+#include <sys/socket.h>
+#include <arpa/inet.h>
+
+#include "Replay.h"
+#include "Capture.h"
+#include "NetworkTools.h"
+
+std::atomic<bool> EHW::Replayer::s_terminate;
+
+void EHW::Replayer::signal_setup()
+{
+    s_terminate = false;
+
+    // Register SIGINT
+    ::signal(SIGINT, [](int) -> void {
+        s_terminate.store(true);
+    });
+
+    // Server closing replayed connections must not kill the replayer
+    ::signal(SIGPIPE, SIG_IGN);
+}
+
+EHW::Replayer::Replayer(const char *server, uint16_t port, const char *capture_path) : m_server{server},
+                                                                                       m_port{port},
+                                                                                       m_capture_path{capture_path},
+                                                                                       m_speed{1.0},
+                                                                                       m_copies{1},
+                                                                                       m_threads{1},
+                                                                                       m_sent_bytes{0},
+                                                                                       m_sent_chunks{0}
+{
+}
+
+void EHW::Replayer::run()
+{
+    // Verify capture before spawning workers
+    CaptureReader reader(m_capture_path.c_str());
+
+    auto threads = std::max(1u, std::min(m_threads, m_copies));
+    m_threads = threads;
+
+    auto start = std::chrono::steady_clock::now();
+
+    std::vector<std::thread> workers;
+    std::vector<std::exception_ptr> errors(threads);
+    for (unsigned i = 0; i < threads; i++) {
+        workers.emplace_back([this, i, &errors]() {
+            try {
+                replay_worker(i);
+            }
+            catch (...) {
+                errors[i] = std::current_exception();
+                s_terminate = true;
+            }
+        });
+    }
+
+    for (auto &w : workers) {
+        w.join();
+    }
+
+    for (auto &e : errors) {
+        if (e) {
+            std::rethrow_exception(e);
+        }
+    }
+
+    auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "Replayed " << m_sent_chunks << " chunks, " << m_sent_bytes << " bytes in " << elapsed << " s ("
+              << (elapsed > 0 ? m_sent_bytes / elapsed / 1e6 : 0) << " MB/s)" << std::endl;
+}
+
+void EHW::Replayer::replay_worker(unsigned worker)
+{
+    CaptureReader reader(m_capture_path.c_str());
+
+    // Copies of the capture handled by this worker
+    std::vector<unsigned> copies;
+    for (auto c = worker; c < m_copies; c += m_threads) {
+        copies.push_back(c);
+    }
+
+    // Open sockets indexed by captured connection, one per copy
+    std::map<uint32_t, std::vector<int>> sockets;
+    auto close_connection = [&sockets](uint32_t connection) {
+        auto it = sockets.find(connection);
+        if (it != sockets.end()) {
+            for (auto sock : it->second) {
+                ::close(sock);
+            }
+            sockets.erase(it);
+        }
+    };
+
+    auto start = std::chrono::steady_clock::now();
+    bool first = true;
+    uint64_t first_timestamp = 0;
+
+    CaptureRecord record;
+    while (!s_terminate.load(std::memory_order_relaxed) && reader.next(record)) {
+        if (first) {
+            first_timestamp = record.timestamp;
+            first = false;
+        }
+
+        // Preserve captured inter-arrival times scaled by speed
+        if (m_speed > 0) {
+            auto offset = std::chrono::nanoseconds(
+                    static_cast<int64_t>((record.timestamp - first_timestamp) / m_speed));
+            // Long gaps in capture are slept in slices, so that termination is not held off
+            auto due = start + offset;
+            while (!s_terminate.load(std::memory_order_relaxed) && std::chrono::steady_clock::now() < due) {
+                std::this_thread::sleep_until(std::min(due, std::chrono::steady_clock::now() + MAX_SLEEP));
+            }
+            if (s_terminate.load(std::memory_order_relaxed)) {
+                break;
+            }
+        }
+
+        if (record.event == CaptureRecord::Event::CLOSE) {
+            close_connection(record.connection);
+            continue;
+        }
+
+        // Connections captured mid-stream are opened on their first data
+        auto it = sockets.find(record.connection);
+        if (it == sockets.end()) {
+            it = sockets.emplace(record.connection, std::vector<int>{}).first;
+            for (size_t i = 0; i < copies.size(); i++) {
+                it->second.push_back(connect());
+            }
+        }
+
+        if (record.event == CaptureRecord::Event::DATA) {
+            for (auto sock : it->second) {
+                send_all(sock, record.data.data(), record.data.size());
+            }
+            m_sent_bytes += record.data.size() * it->second.size();
+            m_sent_chunks += it->second.size();
+        }
+    }
+
+    while (!sockets.empty()) {
+        close_connection(sockets.begin()->first);
+    }
+}
+
+int EHW::Replayer::connect() const
+{
+    ::sockaddr_in remote_addr{};
+    remote_addr.sin_family = AF_INET;
+    remote_addr.sin_port = NetworkTools::endian_swap(m_port);
+
+    int sock;
+    if ((sock = ::socket(AF_INET, SOCK_STREAM, 0)) < 0) {
+        throw std::runtime_error("cannot create socket");
+    }
+
+    if (::inet_pton(AF_INET, m_server, &remote_addr.sin_addr) != 1) {
+        ::close(sock);
+        throw std::runtime_error("invalid IPv4 address");
+    }
+
+    if (::connect(sock, (struct sockaddr *) &remote_addr, sizeof remote_addr) < 0) {
+        ::close(sock);
+        throw std::runtime_error("cannot connect to server");
+    }
+
+    return sock;
+}
+
+void EHW::Replayer::send_all(int sock, const uint8_t *data, size_t len)
+{
+    while (len > 0) {
+        auto sent = ::send(sock, data, len, 0);
+        if (sent < 0) {
+            throw std::runtime_error("unable to send data over socket");
+        }
+        data += sent;
+        len -= sent;
+    }
+}
@@ -0,0 +1,99 @@
+/**
+ * Author: Matej Postolka <matej@postolka.net>
+ * License: BSD 3-clause
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <atomic>
+#include <csignal>
+#include <string>
+#include <chrono>
+
+namespace EHW {
+
+    /**
+     * Replays traffic recorded by CaptureWriter against a server
+     *
+     * Every captured connection is replayed over its own socket. Traffic can be multiplied by replaying
+     * several copies of the capture at once, with copies distributed over worker threads.
+     */
+    class Replayer final {
+
+    private:
+        // Longest time spent sleeping before checking for termination
+        static constexpr auto MAX_SLEEP = std::chrono::milliseconds(100);
+
+        const char *const m_server;
+        const uint16_t m_port;
+        const std::string m_capture_path;
+
+        // Replay speed multiplier, 0 replays as fast as possible
+        double m_speed;
+        // Number of concurrent copies of the capture
+        unsigned m_copies;
+        unsigned m_threads;
+
+        // Set by signal handler and failing workers, lock-free so that it may be written from signal context
+        static std::atomic<bool> s_terminate;
+        static_assert(std::atomic<bool>::is_always_lock_free);
+
+        std::atomic<uint64_t> m_sent_bytes;
+        std::atomic<uint64_t> m_sent_chunks;
+
+    public:
+        static void signal_setup();
+
+        explicit Replayer(const char *server, uint16_t port, const char *capture_path);
+
+        /**
+         * Set replay speed
+         * @param speed Multiplier of captured inter-arrival times, 0 for maximum speed
+         */
+        void set_speed(double speed)
+        { m_speed = speed; }
+
+        /**
+         * Set number of copies of the capture replayed concurrently
+         * @param copies Number of copies
+         */
+        void set_copies(unsigned copies)
+        { m_copies = copies; }
+
+        /**
+         * Set number of worker threads sharing the copies
+         * @param threads Number of threads
+         */
+        void set_threads(unsigned threads)
+        { m_threads = threads; }
+
+        /**
+         * Replay capture and print throughput summary
+         * @throws std::runtime_error
+         */
+        void run();
+
+    private:
+        /**
+         * Replay copies of the capture assigned to worker
+         * @param worker Index of worker thread
+         */
+        void replay_worker(unsigned worker);
+
+        /**
+         * Open new connection to server
+         * @return Connected socket
+         * @throws std::runtime_error
+         */
+        int connect() const;
+
+        /**
+         * Send whole buffer over socket
+         * @throws std::runtime_error
+         */
+        static void send_all(int sock, const uint8_t *data, size_t len);
+
+    };
+
+}
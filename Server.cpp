@@ -7,6 +7,8 @@
 #include <csignal>
 #include <stdexcept>
 #include <ctime>
+#include <string_view>
+#include <functional>
 
 #include <unistd.h>
 #include <sys/ioctl.h>
@@ -17,25 +19,41 @@
 #include "Server.h"
 #include "Device.h"
 #include "NetworkTools.h"
+#include "MagicSearch.h"
 
-bool EHW::Server::s_terminate;
+std::atomic<bool> EHW::Server::s_terminate;
 
 void EHW::Server::signal_setup()
 {
     s_terminate = false;
 
-    // Register SIGINT
-    ::signal(SIGINT, [](int sig) -> void {
-        std::cout << "Caught signal " << sig << ", terminating" << std::endl;
-        s_terminate = true;
+    // Register SIGINT, handler may only use async-signal-safe functions as output may be in progress
+    ::signal(SIGINT, [](int) -> void {
+        static const char msg[] = "Caught SIGINT, terminating\n";
+        ::write(STDOUT_FILENO, msg, sizeof msg - 1);
+        s_terminate.store(true);
     });
 }
 
+size_t EHW::Server::get_min_memory_budget()
+{
+    return Slab<Connection>::get_slab_size() + BufferPool::REGION_SIZE;
+}
+
 EHW::Server::Server(uint16_t port) : m_port{port},
                                      m_socket{-1},
-                                     m_socket_initialized{false}
+                                     m_socket_initialized{false},
+                                     m_throttled{0},
+                                     m_throttle_events{0},
+                                     m_next_connection_id{0},
+                                     m_resync{false},
+                                     m_resync_events{0},
+                                     m_skipped_bytes{0},
+                                     m_exact_counters{true},
+                                     m_pipeline_report_time{0},
+                                     m_loop_time{0}
 {
-
+    set_memory_limits(m_limits);
 }
 
 EHW::Server::~Server()
@@ -43,19 +61,122 @@ EHW::Server::~Server()
     close();
 }
 
+void EHW::Server::set_memory_limits(const MemoryLimits &limits)
+{
+    if (limits.max_frame_size < MIN_MAX_FRAME_SIZE || limits.max_frame_size > limits.buffer_size) {
+        throw std::runtime_error("maximum frame size must fit longest header and receive buffer");
+    }
+    if (limits.budget < get_min_memory_budget()) {
+        throw std::runtime_error("memory budget must fit state of one connection and one buffer region");
+    }
+
+    // Allocators release their memory into budget, destroy them first
+    m_trace_slab.reset();
+    m_connection_slab.reset();
+    m_buffers.reset();
+
+    m_limits = limits;
+    m_budget = std::make_unique<MemoryBudget>(limits.budget);
+    m_buffers = std::make_unique<BufferPool>(limits.buffer_size, limits.huge_pages, *m_budget);
+    m_connection_slab = std::make_unique<Slab<Connection>>(*m_budget);
+    m_trace_slab = std::make_unique<Slab<TraceStats>>(*m_budget);
+}
+
+void EHW::Server::enable_capture(const char *path)
+{
+    m_capture = std::make_unique<CaptureWriter>(path);
+}
+
+void EHW::Server::enable_sketch(const DeviceSketch::Config &config)
+{
+    m_sketch = std::make_unique<DeviceSketch>(config);
+}
+
+void EHW::Server::enable_publisher(uint16_t port, size_t queue_depth, Publisher::DropPolicy drop_policy)
+{
+    m_publisher = std::make_unique<Publisher>(port, queue_depth, drop_policy);
+}
+
+void EHW::Server::enable_arrow(const ArrowWriter::Config &config)
+{
+    m_arrow = std::make_unique<ArrowWriter>(config);
+}
+
+void EHW::Server::enable_alerts(const char *rules_path, const char *alert_path)
+{
+    m_alerts = std::make_unique<AlertEngine>(rules_path, alert_path);
+}
+
+void EHW::Server::enable_relay(const Relay::Config &config)
+{
+    m_relay = std::make_unique<Relay>(config);
+}
+
+void EHW::Server::enable_pipeline(size_t processors)
+{
+    m_processor_states.resize(processors);
+    m_pipeline = std::make_unique<Pipeline<Record>>(
+            processors,
+            [this](size_t processor, Record &record) { process_record(processor, record); },
+            [this](Record &record) { output_record(record); },
+            [this]() { poll_outputs(wall_time()); });
+}
+
 void EHW::Server::run()
 {
     setup_socket();
+    if (m_pipeline) {
+        m_pipeline->start();
+        m_pipeline_report_time = wall_time() + PIPELINE_REPORT_INTERVAL;
+    }
 
     // Accept incoming connections and handle incoming data
-    while (!s_terminate) {
+    while (!s_terminate.load(std::memory_order_relaxed)) {
         handle_incoming();
     }
 
+    // Data packs still in pipeline are counted before printing statistics
+    stop_pipeline();
+
     // Print individual device statistics
     std::cout << std::endl;
+    if (m_publisher) {
+        std::cout << "Readings dropped for slow subscribers: " << m_publisher->get_dropped() << std::endl;
+    }
     for (const auto &item : m_device_counter) {
-        std::cout << "Device: " << item.first << "\ttotal messages received: " << item.second << std::endl;
+        std::cout << "Device: " << item.first << "\ttotal messages received: " << item.second.messages << std::endl;
+    }
+    if (m_sketch) {
+        m_sketch->report(std::cout);
+    }
+    if (m_alerts) {
+        m_alerts->report(std::cout);
+    }
+    if (m_relay) {
+        // Forward last window before reporting what was left unsent
+        m_relay->close();
+        m_relay->report(std::cout);
+    }
+
+    // Print latency statistics of all connections
+    auto trace = m_trace;
+    for (const auto conn : m_connections) {
+        if (conn && conn->trace) {
+            trace.latency.merge(conn->trace->latency);
+            trace.gaps += conn->trace->gaps;
+            trace.reorders += conn->trace->reorders;
+        }
+    }
+    std::cout << "All connections ";
+    print_trace(std::cout, trace);
+    if (m_resync) {
+        std::cout << "Stream resynchronizations: " << m_resync_events << " bytes skipped: " << m_skipped_bytes
+                  << std::endl;
+    }
+    std::cout << "Connection memory used: " << m_budget->get_used() << " of " << m_budget->get_limit()
+              << " bytes, connections throttled: " << m_throttle_events << std::endl;
+    if (m_pipeline) {
+        m_pipeline->report(std::cout);
     }
 }
 
@@ -86,6 +207,16 @@ void EHW::Server::setup_socket()
         throw std::runtime_error("listen() failed");
     }
 
+    if (m_publisher) {
+        try {
+            m_publisher->setup_socket();
+        }
+        catch (...) {
+            ::close(m_socket);
+            throw;
+        }
+    }
+
     m_socket_initialized = true;
 }
 
@@ -103,8 +234,9 @@ void EHW::Server::handle_incoming()
         return;
     }
 
-    // New client connected
-    if (server_pollfd.revents & POLLIN) {
+    // New client connected, it waits in backlog while its state does not fit into memory budget. Slabs must
+    // leave room for one more buffer region, otherwise accepted connections may never receive anything
+    if ((server_pollfd.revents & POLLIN) && m_connection_slab->can_create(BufferPool::REGION_SIZE)) {
         // Accept incoming connection
         int new_socket;
         ::sockaddr_in addr{};
@@ -114,11 +246,7 @@ void EHW::Server::handle_incoming()
             throw std::runtime_error("unable to accept incoming connection");
         }
 
-        // Store handle of incoming connection
-        auto client_pollfd = ::pollfd{};
-        client_pollfd.fd = new_socket;
-        client_pollfd.events = POLLIN;
-        m_poll_set.push_back(client_pollfd);
+        open_connection(new_socket);
     }
 
     // Poll all open socket descriptors
@@ -126,16 +254,23 @@ void EHW::Server::handle_incoming()
         return;
     }
 
+    // All data packs read in this iteration share one receive time
+    update_loop_time();
+
+    if (m_throttled > 0) {
+        resume_throttled();
+    }
+
     for (auto it = m_poll_set.begin(); it != m_poll_set.end(); it++) {
-        // Do nothing if no data was received
-        if (!(it->revents & POLLIN)) {
+        // Do nothing if no data was received, throttled connections only report hangup and errors
+        if (!(it->revents & (POLLIN | POLLRDHUP | POLLHUP | POLLERR))) {
             continue;
         }
 
-        // Check if client terminated connection
-        if (!read_client_data(it->fd)) {
+        // Check if client terminated connection, reading remaining data first
+        if (!(it->revents & POLLIN) || !read_client_data(*it)) {
             // Close connection
-            ::close(it->fd);
+            close_connection(it->fd);
 
             // Remove client from poll set
             it = m_poll_set.erase(it);
@@ -143,66 +278,301 @@ void EHW::Server::handle_incoming()
         }
     }
 
+    if (m_pipeline) {
+        // Hand over data packs of this iteration to idle processing threads, outputs are polled by sink thread
+        m_pipeline->flush();
+        if (m_loop_time >= m_pipeline_report_time) {
+            m_pipeline->report(std::cout);
+            m_pipeline_report_time = m_loop_time + PIPELINE_REPORT_INTERVAL;
+        }
+    }
+    else {
+        poll_outputs(m_loop_time);
+    }
+
+    // Forward ended window and buffered frames upstream
+    if (m_relay) {
+        m_relay->poll(m_loop_time);
+    }
+
 }
 
-bool EHW::Server::read_client_data(int client_sock)
+void EHW::Server::open_connection(int client_sock)
 {
-    // Attempt to read magic sequence
-    uint32_t magic;
-    if (!read_int_value(client_sock, magic)) {
-        return false;
+    // Store handle of incoming connection
+    auto client_pollfd = ::pollfd{};
+    client_pollfd.fd = client_sock;
+    client_pollfd.events = POLLIN;
+    m_poll_set.push_back(client_pollfd);
+
+    // Accepted only when state fits into memory budget
+    auto &conn = *m_connection_slab->create();
+    conn.id = m_next_connection_id++;
+    conn.throttled = false;
+    conn.rx_buffer = nullptr;
+    conn.rx_length = 0;
+    conn.trace = nullptr;
+    conn.resync_events = 0;
+    conn.skipped_bytes = 0;
+
+    if (m_connections.size() <= static_cast<size_t>(client_sock)) {
+        m_connections.resize(client_sock + 1, nullptr);
     }
+    m_connections[client_sock] = &conn;
 
-    if (magic != NetworkTools::endian_swap(*reinterpret_cast<const uint32_t *>(Device::PROTO_MAGIC))) {
-        return false;
+    if (m_capture) {
+        m_capture->record_open(conn.id);
     }
+}
 
-    // Attempt to read device type
-    uint32_t device_type;
-    if (!read_int_value(client_sock, device_type)) {
-        return false;
+void EHW::Server::close_connection(int client_sock)
+{
+    if (static_cast<size_t>(client_sock) < m_connections.size() && m_connections[client_sock]) {
+        auto &conn = *m_connections[client_sock];
+        if (m_capture) {
+            m_capture->record_close(conn.id);
+        }
+
+        // Keep statistics of closed connection in global statistics
+        if (conn.trace) {
+            if (conn.trace->latency.get_count() > 0) {
+                std::cout << "Connection " << conn.id << " closed, ";
+                print_trace(std::cout, *conn.trace);
+            }
+            m_trace.latency.merge(conn.trace->latency);
+            m_trace.gaps += conn.trace->gaps;
+            m_trace.reorders += conn.trace->reorders;
+            m_trace_slab->destroy(conn.trace);
+        }
+        if (conn.resync_events > 0) {
+            std::cout << "Connection " << conn.id << " resynchronizations: " << conn.resync_events
+                      << " bytes skipped: " << conn.skipped_bytes << std::endl;
+        }
+
+        if (conn.rx_buffer) {
+            m_buffers->release(conn.rx_buffer);
+        }
+        if (conn.throttled) {
+            m_throttled--;
+        }
+        m_connection_slab->destroy(&conn);
+        m_connections[client_sock] = nullptr;
     }
 
-    // Attempt to read device ID
-    uint32_t id_length;
-    if (!read_int_value(client_sock, id_length)) {
-        return false;
+    ::close(client_sock);
+}
+
+bool EHW::Server::read_client_data(::pollfd &client)
+{
+    auto &conn = *m_connections[client.fd];
+
+    // Stop polling connection until a buffer is released when budget is exhausted
+    if (!conn.rx_buffer) {
+        conn.rx_buffer = m_buffers->acquire();
+        if (!conn.rx_buffer) {
+            // Peer closing throttled connection is still noticed, data it did not send in full is lost
+            client.events = POLLRDHUP;
+            conn.throttled = true;
+            m_throttled++;
+            m_throttle_events++;
+            return true;
+        }
     }
 
-    std::string device_id;
-    if (!read_str_value(client_sock, device_id, id_length)) {
+    // Read available data directly behind unparsed bytes
+    auto unparsed = conn.rx_length;
+    auto len = ::read(client.fd, conn.rx_buffer + unparsed, m_limits.buffer_size - unparsed);
+    if (len <= 0) {
         return false;
     }
 
-    // Attempt to read device data
-    uint32_t data_len;
-    if (!read_int_value(client_sock, data_len)) {
-        return false;
+    if (m_capture) {
+        m_capture->record_data(conn.id, conn.rx_buffer + unparsed, len);
     }
 
-    std::string data;
-    if (!read_str_value(client_sock, data, data_len)) {
-        return false;
+    // Process all complete data packs
+    const uint8_t *pos = conn.rx_buffer;
+    const uint8_t *end = pos + unparsed + len;
+    while (pos != end) {
+        auto status = parse_data_pack(pos, end, conn);
+        if (status == ParseStatus::INVALID) {
+            if (!m_resync) {
+                return false;
+            }
+
+            // Skip corrupted bytes up to next plausible frame
+            auto next = find_next_frame(pos + 1, end);
+            conn.resync_events++;
+            conn.skipped_bytes += next - pos;
+            m_resync_events++;
+            m_skipped_bytes += next - pos;
+            pos = next;
+            continue;
+        }
+        if (status == ParseStatus::INCOMPLETE) {
+            break;
+        }
     }
 
-    // Track message counts
-    auto data_pack = DataPack(std::move(device_id), static_cast<Device::Type>(device_type), std::move(data));
-    handle_data_pack(data_pack);
+    // Keep incomplete data pack for next read, return buffer to pool if there is none
+    conn.rx_length = end - pos;
+    if (conn.rx_length == 0) {
+        m_buffers->release(conn.rx_buffer);
+        conn.rx_buffer = nullptr;
+    }
+    else {
+        std::memmove(conn.rx_buffer, pos, conn.rx_length);
+    }
 
     return true;
 }
 
-void EHW::Server::handle_data_pack(const DataPack &pack)
+void EHW::Server::resume_throttled()
+{
+    for (auto &client : m_poll_set) {
+        auto &conn = *m_connections[client.fd];
+        if (!conn.throttled) {
+            continue;
+        }
+
+        // Reserve buffer so that resumed connection is not throttled right away
+        conn.rx_buffer = m_buffers->acquire();
+        if (!conn.rx_buffer) {
+            return;
+        }
+
+        client.events = POLLIN;
+        conn.throttled = false;
+        if (--m_throttled == 0) {
+            return;
+        }
+    }
+}
+
+const uint8_t *EHW::Server::find_next_frame(const uint8_t *pos, const uint8_t *end) const
+{
+    while (pos < end) {
+        auto offset = MagicSearch::find(pos, end - pos);
+
+        // Keep bytes which may turn out to be start of magic sequence once more data arrives
+        if (offset == static_cast<size_t>(end - pos)) {
+            auto tail = sizeof Device::PROTO_MAGIC - 1;
+            return static_cast<size_t>(end - pos) > tail ? end - tail : pos;
+        }
+
+        // Magic sequence may occur in data, accept only candidates decoding as frame so far
+        auto candidate = pos + offset;
+        auto cur = candidate;
+        Protocol::Frame frame{};
+        if (Protocol::FrameLayout::decode(cur, end, frame, m_limits.max_frame_size) != ParseStatus::INVALID) {
+            return candidate;
+        }
+
+        pos = candidate + 1;
+    }
+
+    return end;
+}
+
+EHW::Server::ParseStatus EHW::Server::parse_data_pack(const uint8_t *&pos, const uint8_t *end, Connection &conn)
+{
+    // Corrupted and oversized frames are rejected before trusting any length
+    auto begin = pos;
+    Protocol::Frame frame{};
+    auto status = Protocol::FrameLayout::decode(pos, end, frame, m_limits.max_frame_size);
+    if (status != ParseStatus::COMPLETE) {
+        return status;
+    }
+
+    if (frame.type & Device::FLAG_SUMMARY) {
+        Protocol::Summary summary{};
+        if (!Protocol::decode_summary(frame.data, summary)) {
+            pos = begin;
+            return ParseStatus::INVALID;
+        }
+
+        if (m_relay) {
+            m_relay->forward_summary(frame, summary, begin, pos - begin);
+        }
+
+        auto summary_pack = DataPack(std::string(reinterpret_cast<const char *>(frame.id.data), frame.id.length),
+                                     static_cast<Device::Type>(frame.type & Device::TYPE_MASK), std::string(),
+                                     m_loop_time);
+        if (m_pipeline) {
+            submit_record(frame.id, {std::move(summary_pack), conn.id, true, summary});
+        }
+        else {
+            handle_summary(summary_pack, summary);
+        }
+
+        return ParseStatus::COMPLETE;
+    }
+
+    if (m_relay) {
+        m_relay->forward_reading(frame, begin, pos - begin, m_loop_time);
+    }
+
+    auto data_pack = DataPack(std::string(reinterpret_cast<const char *>(frame.id.data), frame.id.length),
+                              static_cast<Device::Type>(frame.type & Device::TYPE_MASK),
+                              std::string(reinterpret_cast<const char *>(frame.data.data), frame.data.length),
+                              m_loop_time);
+    if (frame.type & Device::FLAG_SEND_TIMESTAMP) {
+        data_pack.set_send_time(frame.send_time);
+    }
+    if (frame.type & Device::FLAG_SEQUENCE) {
+        data_pack.set_sequence(frame.sequence);
+    }
+
+    if (m_pipeline) {
+        // Latency is tracked per connection, which only the network stage knows
+        if (data_pack.has_send_time()) {
+            get_trace(conn).latency.record(data_pack.get_send_time(), data_pack.get_receive_time());
+        }
+        submit_record(frame.id, {std::move(data_pack), conn.id, false, {}});
+
+        return ParseStatus::COMPLETE;
+    }
+
+    // Track message counts
+    handle_data_pack(data_pack, conn);
+
+    return ParseStatus::COMPLETE;
+}
+
+void EHW::Server::handle_data_pack(const DataPack &pack, Connection &conn)
 {
     // Increase message counters
+    DeviceCounter *counter = nullptr;
+    if (m_exact_counters) {
+        counter = &m_device_counter[pack.get_id()];
+        counter->messages++;
+    }
+
+    // Track one-way latency and sequence gaps
+    if (pack.has_send_time() || pack.has_sequence()) {
+        trace_data_pack(pack, conn.id, counter, get_trace(conn));
+    }
+
+    output_data_pack(pack);
+}
+
+void EHW::Server::output_data_pack(const DataPack &pack)
+{
     auto device_id = pack.get_id();
-    auto it = m_device_counter.find(device_id);
-    if (it != m_device_counter.end()) {
-        it->second++;
+    if (m_sketch) {
+        m_sketch->update(device_id, pack.get_receive_time(), std::cout);
     }
-        // No message from device received yet
-    else {
-        m_device_counter[device_id] = 1;
+
+    if (m_alerts) {
+        m_alerts->evaluate(pack);
+    }
+
+    if (m_publisher) {
+        m_publisher->publish(pack);
+    }
+
+    if (m_arrow) {
+        m_arrow->append(pack);
     }
 
     // Print information to stdout
@@ -210,6 +580,167 @@ void EHW::Server::handle_data_pack(const DataPack &pack)
               << " data: " << pack.get_data() << " ts: " << pack.get_timestamp() << std::endl;
 }
 
+void EHW::Server::handle_summary(const DataPack &pack, const Protocol::Summary &summary)
+{
+    if (m_exact_counters) {
+        m_device_counter[pack.get_id()].messages += summary.messages;
+    }
+
+    output_summary(pack, summary);
+}
+
+void EHW::Server::output_summary(const DataPack &pack, const Protocol::Summary &summary)
+{
+    // Print information to stdout
+    std::cout << "Received summary from device: " << pack.get_id() << " type: " << static_cast<int>(pack.get_type())
+              << " messages: " << summary.messages;
+    if (summary.values > 0) {
+        std::cout << " min: " << summary.min << " max: " << summary.max << " mean: "
+                  << summary.sum / static_cast<double>(summary.values);
+    }
+    std::cout << " ts: " << pack.get_timestamp() << std::endl;
+}
+
+void EHW::Server::process_record(size_t processor, Record &record)
+{
+    if (!m_exact_counters) {
+        return;
+    }
+
+    auto &state = m_processor_states[processor];
+    auto &counter = state.counters[record.pack.get_id()];
+    if (record.has_summary) {
+        counter.messages += record.summary.messages;
+        return;
+    }
+
+    counter.messages++;
+    track_sequence(record.pack, record.connection, counter, state.trace);
+}
+
+void EHW::Server::output_record(Record &record)
+{
+    if (record.has_summary) {
+        output_summary(record.pack, record.summary);
+    }
+    else {
+        output_data_pack(record.pack);
+    }
+}
+
+void EHW::Server::submit_record(const Protocol::Span &id, Record &&record)
+{
+    // Devices are partitioned across processing threads by hash of identifier
+    auto handle = std::hash<std::string_view>{}(std::string_view(reinterpret_cast<const char *>(id.data), id.length));
+    m_pipeline->submit(handle, std::move(record));
+}
+
+void EHW::Server::stop_pipeline()
+{
+    if (!m_pipeline) {
+        return;
+    }
+
+    m_pipeline->stop();
+
+    // Processing threads own disjoint sets of devices
+    for (auto &state : m_processor_states) {
+        for (const auto &item : state.counters) {
+            m_device_counter[item.first].messages += item.second.messages;
+        }
+        m_trace.gaps += state.trace.gaps;
+        m_trace.reorders += state.trace.reorders;
+
+        state.counters.clear();
+        state.trace = TraceStats{};
+    }
+}
+
+void EHW::Server::poll_outputs(uint64_t now)
+{
+    // Deliver readings received since last call
+    if (m_publisher) {
+        m_publisher->handle_subscribers();
+    }
+
+    // Write readings buffered for too long
+    if (m_arrow) {
+        m_arrow->poll(now);
+    }
+}
+
+void EHW::Server::update_loop_time()
+{
+    m_loop_time = wall_time();
+}
+
+uint64_t EHW::Server::wall_time()
+{
+    // Wall clock is required to compare against send timestamps of other hosts
+    ::timespec now{};
+    ::clock_gettime(CLOCK_REALTIME, &now);
+
+    return static_cast<uint64_t>(now.tv_sec) * 1000000000 + now.tv_nsec;
+}
+
+EHW::Server::TraceStats &EHW::Server::get_trace(Connection &conn)
+{
+    // Histograms are large compared to connection state, idle connections do not hold any
+    if (!conn.trace && m_trace_slab->can_create(BufferPool::REGION_SIZE)) {
+        conn.trace = m_trace_slab->create();
+    }
+
+    return conn.trace ? *conn.trace : m_trace;
+}
+
+void EHW::Server::trace_data_pack(const DataPack &pack, uint32_t connection, DeviceCounter *counter,
+                                  TraceStats &trace)
+{
+    if (pack.has_send_time()) {
+        trace.latency.record(pack.get_send_time(), pack.get_receive_time());
+    }
+
+    // Sequence tracking needs per-device state
+    if (counter) {
+        track_sequence(pack, connection, *counter, trace);
+    }
+}
+
+void EHW::Server::track_sequence(const DataPack &pack, uint32_t connection, DeviceCounter &counter,
+                                 TraceStats &trace)
+{
+    if (!pack.has_sequence()) {
+        return;
+    }
+
+    auto sequence = pack.get_sequence();
+    if (counter.has_sequence) {
+        // Signed distance from expected sequence number handles wraparound
+        auto distance = static_cast<int32_t>(sequence - counter.last_sequence - 1);
+        if (distance > 0) {
+            trace.gaps += distance;
+        }
+        else if (distance < 0) {
+            // Far backward jump or new connection means the device restarted its sequence, follow it
+            if (distance >= -MAX_REORDER_DISTANCE && connection == counter.last_connection) {
+                trace.reorders++;
+                return;
+            }
+        }
+    }
+
+    counter.last_sequence = sequence;
+    counter.last_connection = connection;
+    counter.has_sequence = true;
+}
+
+void EHW::Server::print_trace(std::ostream &s, const TraceStats &trace)
+{
+    s << "latency: ";
+    trace.latency.print(s);
+    s << ", sequence gaps: " << trace.gaps << " reorders: " << trace.reorders << std::endl;
+}
+
 void EHW::Server::close()
 {
     if (!m_socket_initialized)
@@ -220,18 +751,35 @@ void EHW::Server::close()
     // Close listening socket
     ::close(m_socket);
 
+    // Sink thread uses publisher and export until pipeline stops
+    stop_pipeline();
+
+    if (m_publisher) {
+        m_publisher->close();
+    }
+
+    if (m_arrow) {
+        m_arrow->close();
+    }
+
+    if (m_relay) {
+        m_relay->close();
+    }
+
     // Close all client connections
     for (auto &conn : m_poll_set) {
-        ::close(conn.fd);
+        close_connection(conn.fd);
     }
     m_poll_set.clear();
 }
 
-EHW::DataPack::DataPack(std::string &&device_id, Device::Type device_type, std::string &&data) : m_device_id{device_id},
-                                                                                                 m_device_type{
-                                                                                                         device_type},
-                                                                                                 m_data{data},
-                                                                                                 m_timestamp{std::time(
-                                                                                                         nullptr)}
+EHW::DataPack::DataPack(std::string &&device_id, Device::Type device_type, std::string &&data,
+                        uint64_t receive_time) : m_device_id{device_id},
+                                                 m_device_type{device_type},
+                                                 m_data{data},
+                                                 m_receive_time{receive_time},
+                                                 m_send_time{0},
+                                                 m_sequence{0},
+                                                 m_has_sequence{false}
 {
-}
\ No newline at end of file
+}
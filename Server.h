@@ -9,12 +9,27 @@
 #include <vector>
 #include <ctime>
 #include <map>
+#include <memory>
+#include <cstring>
+#include <atomic>
 
 #include <unistd.h>
 #include <poll.h>
 
 #include "NetworkTools.h"
+#include "Protocol.h"
 #include "Device.h"
+#include "Capture.h"
+#include "Publisher.h"
+#include "LatencyHistogram.h"
+#include "DeviceSketch.h"
+#include "ArrowWriter.h"
+#include "AlertEngine.h"
+#include "Relay.h"
+#include "MemoryBudget.h"
+#include "BufferPool.h"
+#include "Slab.h"
+#include "Pipeline.h"
 
 namespace EHW {
 
@@ -24,10 +39,25 @@ namespace EHW {
         std::string m_device_id;
         Device::Type m_device_type;
         std::string m_data;
-        std::time_t m_timestamp;
+        // Receive time in nanoseconds since epoch
+        uint64_t m_receive_time;
+        // Send time in nanoseconds since epoch, 0 if not provided by device
+        uint64_t m_send_time;
+        uint32_t m_sequence;
+        bool m_has_sequence;
 
     public:
-        explicit DataPack(std::string &&device_id, Device::Type device_type, std::string &&m_data);
+        explicit DataPack(std::string &&device_id, Device::Type device_type, std::string &&m_data,
+                          uint64_t receive_time);
+
+        void set_send_time(uint64_t send_time)
+        { m_send_time = send_time; }
+
+        void set_sequence(uint32_t sequence)
+        {
+            m_sequence = sequence;
+            m_has_sequence = true;
+        }
 
         [[nodiscard]]
         inline auto get_id() const
@@ -41,35 +71,265 @@ namespace EHW {
         inline auto get_data() const
         { return m_data; }
 
+        /**
+         * Get receive time with one second resolution
+         * @return Receive time in seconds since epoch
+         */
+        [[nodiscard]]
+        inline std::time_t get_timestamp() const
+        { return static_cast<std::time_t>(m_receive_time / 1000000000); }
+
         [[nodiscard]]
-        inline auto get_timestamp() const
-        { return m_timestamp; }
+        inline auto get_receive_time() const
+        { return m_receive_time; }
+
+        [[nodiscard]]
+        inline auto get_send_time() const
+        { return m_send_time; }
+
+        [[nodiscard]]
+        inline auto get_sequence() const
+        { return m_sequence; }
+
+        [[nodiscard]]
+        inline auto has_send_time() const
+        { return m_send_time != 0; }
+
+        [[nodiscard]]
+        inline auto has_sequence() const
+        { return m_has_sequence; }
 
     };
 
     class Server final {
 
+    public:
+        // Largest frame with longest identifier, no data and all trailers
+        static constexpr size_t MIN_MAX_FRAME_SIZE = Protocol::FRAME_OVERHEAD + Protocol::MAX_ID_LENGTH;
+
+        /**
+         * Limits of memory held by connections
+         */
+        struct MemoryLimits {
+            // Memory of all connection state and receive buffers in bytes
+            size_t budget = 1024 * 1024 * 1024;
+            // Size of receive buffer, which is the most a single connection may buffer
+            size_t buffer_size = 16384;
+            // Largest accepted frame, at most buffer_size
+            size_t max_frame_size = 16384;
+            // Back receive buffers by huge pages
+            bool huge_pages = false;
+        };
+
     private:
         static constexpr int SOCKET_BACKLOG = 32;
+        // Interval of pipeline queue reports in nanoseconds
+        static constexpr uint64_t PIPELINE_REPORT_INTERVAL = 10000000000;
+        // Largest backward jump of sequence number counted as reorder, larger ones restart the sequence
+        static constexpr int32_t MAX_REORDER_DISTANCE = 1024;
+
+        /**
+         * One-way latency and sequence statistics
+         */
+        struct TraceStats {
+            LatencyHistogram latency;
+            // Sequence numbers skipped by devices
+            uint64_t gaps = 0;
+            // Sequence numbers received out of order or repeatedly
+            uint64_t reorders = 0;
+        };
+
+        /**
+         * State of single client connection
+         */
+        struct Connection {
+            // Server-assigned identifier, unique for the lifetime of the server
+            uint32_t id;
+            // Not polled for input until a receive buffer is available
+            bool throttled;
+            // Pooled buffer of received bytes not yet parsed into data packs, held only while there are any
+            uint8_t *rx_buffer;
+            size_t rx_length;
+            // Trace statistics allocated on first traced data pack, nullptr before and while budget is exhausted
+            TraceStats *trace;
+            // Number of times the stream was resynchronized and bytes skipped doing so
+            uint64_t resync_events;
+            uint64_t skipped_bytes;
+        };
+
+        /**
+         * Per-device message statistics
+         */
+        struct DeviceCounter {
+            uint64_t messages = 0;
+            // Highest sequence number received so far and connection it was received on
+            uint32_t last_sequence = 0;
+            uint32_t last_connection = 0;
+            bool has_sequence = false;
+        };
+
+        /**
+         * Data pack or summary passed through pipeline
+         */
+        struct Record {
+            DataPack pack;
+            // Identifier of connection the data pack was received on
+            uint32_t connection;
+            // Summary of readings aggregated by relay server, pack holds no data then
+            bool has_summary;
+            Protocol::Summary summary;
+        };
+
+        /**
+         * Device state owned by single processing thread of pipeline
+         */
+        struct ProcessorState {
+            std::map<std::string, DeviceCounter> counters;
+            // Sequence statistics, latency is tracked per connection by network stage
+            TraceStats trace;
+        };
+
+        // Result of attempt to parse one data pack from receive buffer
+        using ParseStatus = Protocol::Status;
+
         const uint16_t m_port;
 
         int m_socket;
         bool m_socket_initialized;
         std::vector<::pollfd> m_poll_set;
 
-        // Set by signal handler
-        static bool s_terminate;
+        // Memory held by connections is bounded by budget
+        MemoryLimits m_limits;
+        std::unique_ptr<MemoryBudget> m_budget;
+        std::unique_ptr<BufferPool> m_buffers;
+        std::unique_ptr<Slab<Connection>> m_connection_slab;
+        std::unique_ptr<Slab<TraceStats>> m_trace_slab;
+        // Connections not polled for input until receive buffers are available again
+        size_t m_throttled;
+        uint64_t m_throttle_events;
+
+        // Open client connections indexed by socket, nullptr for sockets not used by connections
+        std::vector<Connection *> m_connections;
+        uint32_t m_next_connection_id;
+
+        // Skip corrupted data instead of dropping connection
+        bool m_resync;
+        uint64_t m_resync_events;
+        uint64_t m_skipped_bytes;
+
+        // Optional recorder of inbound traffic
+        std::unique_ptr<CaptureWriter> m_capture;
+        // Optional live fan-out of readings to subscribers
+        std::unique_ptr<Publisher> m_publisher;
+        // Optional columnar export of readings
+        std::unique_ptr<ArrowWriter> m_arrow;
+        // Optional evaluation of alert rules
+        std::unique_ptr<AlertEngine> m_alerts;
+        // Optional forwarding of readings to upstream server
+        std::unique_ptr<Relay> m_relay;
+
+        // Set by signal handler, lock-free so that it may be written from signal context
+        static std::atomic<bool> s_terminate;
+        static_assert(std::atomic<bool>::is_always_lock_free);
 
         // Message counter for individual devices
-        std::map<std::string, int> m_device_counter;
+        std::map<std::string, DeviceCounter> m_device_counter;
+        bool m_exact_counters;
+        // Optional bounded-memory device statistics
+        std::unique_ptr<DeviceSketch> m_sketch;
+
+        // Optional staged processing of data packs on separate threads
+        std::unique_ptr<Pipeline<Record>> m_pipeline;
+        // Per-device counters of processing threads, merged into m_device_counter when pipeline stops
+        std::vector<ProcessorState> m_processor_states;
+        uint64_t m_pipeline_report_time;
+
+        // Receive time shared by all data packs of current event loop iteration
+        uint64_t m_loop_time;
+        // Trace statistics of already closed connections and of connections without their own
+        TraceStats m_trace;
 
     public:
         static void signal_setup();
 
+        /**
+         * Get smallest memory budget which fits state of one connection and one region of receive buffers
+         * @return Budget in bytes
+         */
+        static size_t get_min_memory_budget();
+
         explicit Server(uint16_t port);
 
         ~Server();
 
+        /**
+         * Set limits of memory held by connections, must be called before the server is started
+         * @param limits Memory limits
+         * @throws std::runtime_error on invalid limits
+         */
+        void set_memory_limits(const MemoryLimits &limits);
+
+        /**
+         * Record raw inbound traffic of all connections into capture file
+         * @param path Path of capture file
+         * @throws std::runtime_error
+         */
+        void enable_capture(const char *path);
+
+        /**
+         * Collect bounded-memory statistics of devices
+         * @param config Sketch configuration
+         */
+        void enable_sketch(const DeviceSketch::Config &config);
+
+        /**
+         * Stop keeping exact per-device counters, whose memory grows with number of devices
+         */
+        void disable_exact_counters()
+        { m_exact_counters = false; }
+
+        /**
+         * Resynchronize on next valid frame header instead of dropping connection with corrupted stream
+         */
+        void enable_resync()
+        { m_resync = true; }
+
+        /**
+         * Publish received readings to subscribers connecting on given port
+         * @param port TCP port for subscribers
+         * @param queue_depth Maximum number of readings queued per subscriber
+         * @param drop_policy Behaviour of full subscriber queue
+         */
+        void enable_publisher(uint16_t port, size_t queue_depth, Publisher::DropPolicy drop_policy);
+
+        /**
+         * Export received readings into Apache Arrow IPC stream files
+         * @param config Export configuration
+         */
+        void enable_arrow(const ArrowWriter::Config &config);
+
+        /**
+         * Evaluate alert rules on received readings
+         * @param rules_path Path of rules file
+         * @param alert_path Path of file receiving alerts, standard error output if nullptr
+         * @throws std::runtime_error
+         */
+        void enable_alerts(const char *rules_path, const char *alert_path);
+
+        /**
+         * Forward received readings or their summaries to upstream server
+         * @param config Relay configuration
+         * @throws std::runtime_error
+         */
+        void enable_relay(const Relay::Config &config);
+
+        /**
+         * Process data packs in pipeline: event loop parses frames, processing threads own per-device counters
+         * partitioned by device, and sink thread handles sketch, alerts, subscribers, export and printing
+         * @param processors Number of processing threads
+         */
+        void enable_pipeline(size_t processors);
+
         /**
          * Begin receiving data from devices at specified port
          * @throws std::runtime_error
@@ -90,46 +350,147 @@ namespace EHW {
         void handle_incoming();
 
         /**
-         * Read 8 to 64-bit integer values from device in network byte order and convert to host byte order
-         * @tparam T value type
-         * @param fd file descriptor
-         * @param value destination
-         * @return true if successfully read, otherwise false
+         * Process data pack received from device (increment counters, track latency, print information)
+         * @param pack Data pack
+         * @param conn Connection the data pack was received on
          */
-        template<typename T>
-        static bool read_int_value(int fd, T &value)
-        {
-            if (::read(fd, &value, sizeof value) != sizeof value) {
-                return false;
-            }
+        void handle_data_pack(const DataPack &pack, Connection &conn);
 
-            value = NetworkTools::endian_swap(value);
+        /**
+         * Pass data pack to sketch, alerts, subscribers and export, and print information
+         * @param pack Data pack
+         */
+        void output_data_pack(const DataPack &pack);
 
-            return true;
-        }
+        /**
+         * Process summary of readings received from relay server (increment counters, print information)
+         * @param pack Data pack identifying device
+         * @param summary Summary
+         */
+        void handle_summary(const DataPack &pack, const Protocol::Summary &summary);
 
-        static bool read_str_value(int fd, std::string &str, size_t len)
-        {
-            str.resize(len);
-            if (::read(fd, str.data(), str.size()) != len) {
-                return false;
-            }
+        /**
+         * Print summary of readings received from relay server
+         * @param pack Data pack identifying device
+         * @param summary Summary
+         */
+        static void output_summary(const DataPack &pack, const Protocol::Summary &summary);
 
-            return true;
-        }
+        /**
+         * Processing stage of pipeline, updates counters owned by processing thread
+         * @param processor Index of processing thread
+         * @param record Data pack or summary
+         */
+        void process_record(size_t processor, Record &record);
+
+        /**
+         * Sink stage of pipeline
+         * @param record Data pack or summary
+         */
+        void output_record(Record &record);
 
         /**
-         * Process data pack received from device (increment counters, print information)
+         * Hand data pack or summary over to pipeline
+         * @param id Device identifier
+         * @param record Data pack or summary
+         */
+        void submit_record(const Protocol::Span &id, Record &&record);
+
+        /**
+         * Wait for pipeline to drain and merge statistics of processing threads
+         */
+        void stop_pipeline();
+
+        /**
+         * Deliver readings to subscribers and write exported readings buffered for too long
+         * @param now Current time in nanoseconds since epoch
+         */
+        void poll_outputs(uint64_t now);
+
+        /**
+         * Find start of next plausible frame in buffer
+         * @param pos position to start searching from
+         * @param end end of buffer
+         * @return start of next frame, or start of trailing bytes which may be part of one
+         */
+        const uint8_t *find_next_frame(const uint8_t *pos, const uint8_t *end) const;
+
+        /**
+         * Parse single data pack from buffer and process it
+         * @param pos start of data pack, advanced past the data pack if complete
+         * @param end end of buffer
+         * @param conn Connection the buffer belongs to
+         * @return parse status
+         */
+        ParseStatus parse_data_pack(const uint8_t *&pos, const uint8_t *end, Connection &conn);
+
+        /**
+         * Refresh cached receive time, called once per event loop iteration
+         */
+        void update_loop_time();
+
+        /**
+         * Get wall clock time
+         * @return Time in nanoseconds since epoch
+         */
+        static uint64_t wall_time();
+
+        /**
+         * Get trace statistics of connection, allocating them if budget allows
+         * @param conn Connection
+         * @return Statistics of connection, or shared statistics if they cannot be allocated
+         */
+        TraceStats &get_trace(Connection &conn);
+
+        /**
+         * Update trace statistics with data pack
          * @param pack Data pack
+         * @param connection Identifier of connection the data pack was received on
+         * @param counter Statistics of device which sent the data pack, nullptr if not tracked
+         * @param trace Statistics to update
          */
-        void handle_data_pack(const DataPack &pack);
+        static void trace_data_pack(const DataPack &pack, uint32_t connection, DeviceCounter *counter, TraceStats &trace);
 
         /**
-         * Read and parse data from client socket
-         * @param client_sock Socket of client to read data from
+         * Update sequence statistics with data pack, restarting the sequence of device when it jumps back far
+         * or on a new connection, e.g. after the client restarted
+         * @param pack Data pack
+         * @param connection Identifier of connection the data pack was received on
+         * @param counter Statistics of device which sent the data pack
+         * @param trace Statistics to update
+         */
+        static void track_sequence(const DataPack &pack, uint32_t connection, DeviceCounter &counter, TraceStats &trace);
+
+        /**
+         * Print trace statistics
+         * @param s Output stream
+         * @param trace Statistics to print
+         */
+        static void print_trace(std::ostream &s, const TraceStats &trace);
+
+        /**
+         * Read and parse data from client socket, throttling the client if no receive buffer is available
+         * @param client Poll entry of client to read data from
          * @return true if read was successfull, false otherwise
          */
-        bool read_client_data(int client_sock);
+        bool read_client_data(::pollfd &client);
+
+        /**
+         * Resume polling throttled connections for which receive buffers are available
+         */
+        void resume_throttled();
+
+        /**
+         * Start tracking newly accepted client connection
+         * @param client_sock Socket of client
+         */
+        void open_connection(int client_sock);
+
+        /**
+         * Close client connection and drop its state
+         * @param client_sock Socket of client
+         */
+        void close_connection(int client_sock);
 
         /**
          * Close listening socket if open
@@ -0,0 +1,154 @@
+/**
+ * Author: Matej Postolka <matej@postolka.net>
+ * License: BSD 3-clause
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <memory>
+#include <new>
+#include <utility>
+
+#include "MemoryBudget.h"
+
+namespace EHW {
+
+    /**
+     * Allocator of objects of single type from fixed-size slabs
+     *
+     * Slabs are allocated on demand from the memory budget and never returned, freed objects are reused
+     * through an intrusive free list. Objects are thus packed densely and creating or destroying one does not
+     * touch the system allocator in steady state.
+     *
+     * @tparam T Type of objects
+     */
+    template<typename T>
+    class Slab final {
+
+    public:
+        // Number of objects in single slab
+        static constexpr size_t OBJECTS_PER_SLAB = 256;
+
+    private:
+        /**
+         * Storage of single object, holding link to next free slot while unused
+         */
+        union Slot {
+            Slot *next;
+            alignas(T) unsigned char object[sizeof(T)];
+        };
+
+        MemoryBudget &m_budget;
+        std::vector<std::unique_ptr<Slot[]>> m_slabs;
+        Slot *m_free;
+        size_t m_size;
+
+    public:
+        /**
+         * Create empty allocator
+         * @param budget Memory budget slabs are reserved from
+         */
+        explicit Slab(MemoryBudget &budget) : m_budget{budget},
+                                              m_free{nullptr},
+                                              m_size{0}
+        {
+        }
+
+        /**
+         * Destroy allocator, all objects must have been destroyed before
+         */
+        ~Slab()
+        {
+            m_budget.release(m_slabs.size() * get_slab_size());
+        }
+
+        Slab(const Slab &) = delete;
+
+        Slab &operator=(const Slab &) = delete;
+
+        /**
+         * Construct new object
+         * @param args Arguments of constructor
+         * @return Pointer to object, nullptr if memory budget is exhausted
+         */
+        template<typename... Args>
+        T *create(Args &&... args)
+        {
+            if (!m_free && !grow()) {
+                return nullptr;
+            }
+
+            auto slot = m_free;
+            m_free = slot->next;
+            m_size++;
+
+            return new(slot->object) T(std::forward<Args>(args)...);
+        }
+
+        /**
+         * Destroy object and return its storage to allocator
+         * @param object Object created by this allocator
+         */
+        void destroy(T *object)
+        {
+            object->~T();
+
+            auto slot = reinterpret_cast<Slot *>(object);
+            slot->next = m_free;
+            m_free = slot;
+            m_size--;
+        }
+
+        /**
+         * Check whether another object can be created without exceeding memory budget
+         * @param headroom Bytes of budget which must remain available after allocating new slab
+         * @return true if object can be created
+         */
+        [[nodiscard]]
+        bool can_create(size_t headroom = 0) const
+        {
+            return m_free || m_budget.get_limit() - m_budget.get_used() >= get_slab_size() + headroom;
+        }
+
+        /**
+         * Get memory reserved from budget by single slab
+         * @return Size of slab in bytes
+         */
+        static constexpr size_t get_slab_size()
+        { return OBJECTS_PER_SLAB * sizeof(Slot); }
+
+        /**
+         * Get number of live objects
+         * @return Number of objects
+         */
+        [[nodiscard]]
+        size_t size() const
+        { return m_size; }
+
+    private:
+        /**
+         * Allocate new slab and thread its slots onto free list
+         * @return false if memory budget is exhausted
+         */
+        bool grow()
+        {
+            if (!m_budget.reserve(get_slab_size())) {
+                return false;
+            }
+
+            m_slabs.emplace_back(new Slot[OBJECTS_PER_SLAB]);
+            auto slab = m_slabs.back().get();
+            for (size_t i = 0; i < OBJECTS_PER_SLAB; i++) {
+                slab[i].next = m_free;
+                m_free = &slab[i];
+            }
+
+            return true;
+        }
+
+    };
+
+}
@@ -0,0 +1,127 @@
+/**
+ * Author: Matej Postolka <matej@postolka.net>
+ * License: BSD 3-clause
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <atomic>
+#include <utility>
+#include <stdexcept>
+
+namespace EHW {
+
+    /**
+     * Bounded lock-free queue between exactly one producer thread and one consumer thread
+     *
+     * Slots form a ring indexed by ever-increasing positions. Each side owns one position and only reads the
+     * other's, keeping a cached copy of it so that the shared cache line is touched only when the ring looks
+     * full or empty.
+     *
+     * @tparam T Type of values, moved in and out of the queue
+     */
+    template<typename T>
+    class SpscQueue final {
+
+    private:
+        // Keeps positions of producer and consumer on separate cache lines
+        static constexpr size_t CACHE_LINE_SIZE = 64;
+
+        std::vector<T> m_slots;
+        const size_t m_mask;
+
+        // Next position read by consumer, with consumer's copy of producer position
+        alignas(CACHE_LINE_SIZE) std::atomic<size_t> m_head;
+        size_t m_tail_cache;
+
+        // Next position written by producer, with producer's copy of consumer position
+        alignas(CACHE_LINE_SIZE) std::atomic<size_t> m_tail;
+        size_t m_head_cache;
+
+    public:
+        /**
+         * Create empty queue
+         * @param capacity Number of slots, power of two
+         * @throws std::runtime_error on invalid capacity
+         */
+        explicit SpscQueue(size_t capacity) : m_slots(capacity),
+                                              m_mask{capacity - 1},
+                                              m_head{0},
+                                              m_tail_cache{0},
+                                              m_tail{0},
+                                              m_head_cache{0}
+        {
+            if (capacity == 0 || (capacity & (capacity - 1)) != 0) {
+                throw std::runtime_error("queue capacity must be power of two");
+            }
+        }
+
+        SpscQueue(const SpscQueue &) = delete;
+
+        SpscQueue &operator=(const SpscQueue &) = delete;
+
+        /**
+         * Append value, called by producer only
+         * @param value Value, moved from only if appended
+         * @return false if queue is full
+         */
+        bool try_push(T &value)
+        {
+            auto tail = m_tail.load(std::memory_order_relaxed);
+            if (tail - m_head_cache == m_slots.size()) {
+                m_head_cache = m_head.load(std::memory_order_acquire);
+                if (tail - m_head_cache == m_slots.size()) {
+                    return false;
+                }
+            }
+
+            m_slots[tail & m_mask] = std::move(value);
+            m_tail.store(tail + 1, std::memory_order_release);
+
+            return true;
+        }
+
+        /**
+         * Remove oldest value, called by consumer only
+         * @param value Destination of value
+         * @return false if queue is empty
+         */
+        bool try_pop(T &value)
+        {
+            auto head = m_head.load(std::memory_order_relaxed);
+            if (head == m_tail_cache) {
+                m_tail_cache = m_tail.load(std::memory_order_acquire);
+                if (head == m_tail_cache) {
+                    return false;
+                }
+            }
+
+            value = std::move(m_slots[head & m_mask]);
+            m_head.store(head + 1, std::memory_order_release);
+
+            return true;
+        }
+
+        /**
+         * Get number of queued values, exact when called by either side and approximate otherwise
+         * @return Number of values
+         */
+        [[nodiscard]]
+        size_t size() const
+        {
+            // Consumer position never passes producer position loaded after it
+            auto head = m_head.load(std::memory_order_acquire);
+
+            return m_tail.load(std::memory_order_acquire) - head;
+        }
+
+        [[nodiscard]]
+        size_t capacity() const
+        { return m_slots.size(); }
+
+    };
+
+}
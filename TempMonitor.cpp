@@ -5,8 +5,8 @@
 
 #include "TempMonitor.h"
 
-EHW::TempMonitor::TempMonitor(const char *identifier) : Device(identifier, Type::TEMP_MONITOR),
-                                                        m_distribution{TEMP_LB, TEMP_UB}
+EHW::TempMonitor::TempMonitor(const char *identifier, size_t length) : Device(identifier, length, Type::TEMP_MONITOR),
+                                                                       m_distribution{TEMP_LB, TEMP_UB}
 {
     update_internal_state();
 }
@@ -18,12 +18,9 @@ uint64_t EHW::TempMonitor::get_poll_delay() const
 
 void EHW::TempMonitor::serialize()
 {
-    // Create initial serialized buffer
-    initialize_buffer();
-
-    // Append current temperature
+    // Encode frame with current temperature
     auto temp_str = std::to_string(m_current_temp);
-    add_str_to_buffer(temp_str);
+    serialize_frame(temp_str);
 }
 
 void EHW::TempMonitor::update_internal_state()
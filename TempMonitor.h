@@ -16,7 +16,7 @@ namespace EHW {
      */
     class TempMonitor final : public Device {
 
-    private:
+    public:
         // Lower bound of randomly generated temperatures
         static constexpr double TEMP_LB = 0.0;
         // Upper bound of randomly generated temperatures
@@ -24,13 +24,14 @@ namespace EHW {
         // Statically set polling delay
         static constexpr int POLL_DELAY = 1000;
 
+    private:
         std::uniform_real_distribution<double> m_distribution;
         std::default_random_engine m_re;
 
         double m_current_temp;
 
     public:
-        explicit TempMonitor(const char *identifier);
+        explicit TempMonitor(const char *identifier, size_t length);
 
         [[nodiscard]]
         uint64_t get_poll_delay() const override;
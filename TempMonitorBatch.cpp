@@ -0,0 +1,145 @@
+/**
+ * Author: Matej Postolka <matej@postolka.net>
+ * License: BSD 3-clause
+ */
+
+#include <charconv>
+#include <cstring>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+#include "TempMonitorBatch.h"
+#include "TempMonitor.h"
+
+EHW::TempMonitorBatch::TempMonitorBatch() : DeviceBatch(Device::Type::TEMP_MONITOR)
+{
+}
+
+void EHW::TempMonitorBatch::reserve(size_t count, size_t identifier_bytes)
+{
+    DeviceBatch::reserve(count, identifier_bytes);
+    m_current_temps.reserve(m_current_temps.size() + count);
+    m_rng_s0.reserve(m_rng_s0.size() + count);
+    m_rng_s1.reserve(m_rng_s1.size() + count);
+}
+
+void EHW::TempMonitorBatch::add_device(const char *identifier, size_t length)
+{
+    DeviceBatch::add_device(identifier, length);
+    auto index = size() - 1;
+
+    // Seed generator from identifier using splitmix64, state must not be all zeros
+    auto seed = device_seed(index);
+    auto splitmix = [&seed]() {
+        auto z = (seed += 0x9e3779b97f4a7c15);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+        return z ^ (z >> 31);
+    };
+    m_rng_s0.push_back(splitmix());
+    m_rng_s1.push_back(splitmix() | 1);
+    m_current_temps.push_back(0.0);
+
+    // Devices start with a valid reading, as TempMonitor does
+    update_range(index, index + 1);
+}
+
+uint64_t EHW::TempMonitorBatch::get_poll_delay() const
+{
+    return TempMonitor::POLL_DELAY;
+}
+
+void EHW::TempMonitorBatch::update_internal_state()
+{
+    update_range(0, size());
+}
+
+void EHW::TempMonitorBatch::serialize(size_t begin, size_t end, std::vector<uint8_t> &buffer)
+{
+    serialize_frames<MAX_VALUE_LENGTH>(begin, end, buffer, [this](size_t i, char *dest) {
+        return format_temp(m_current_temps[i], dest);
+    });
+}
+
+void EHW::TempMonitorBatch::serialize(const uint32_t *indices, size_t count, std::vector<uint8_t> &buffer)
+{
+    serialize_frames<MAX_VALUE_LENGTH>(indices, indices + count, buffer, [this](size_t i, char *dest) {
+        return format_temp(m_current_temps[i], dest);
+    });
+}
+
+void EHW::TempMonitorBatch::update_range(size_t begin, size_t end)
+{
+    constexpr double range = TempMonitor::TEMP_UB - TempMonitor::TEMP_LB;
+    // Exponent of doubles in range [1, 2)
+    constexpr uint64_t one_exponent = 0x3ff0000000000000;
+
+    auto s0 = m_rng_s0.data();
+    auto s1 = m_rng_s1.data();
+    auto temps = m_current_temps.data();
+    auto i = begin;
+
+#if defined(__AVX2__)
+    const auto v_exponent = _mm256_set1_epi64x(one_exponent);
+    const auto v_one = _mm256_set1_pd(1.0);
+    const auto v_range = _mm256_set1_pd(range);
+    const auto v_lb = _mm256_set1_pd(TempMonitor::TEMP_LB);
+
+    for (; i + 4 <= end; i += 4) {
+        auto x = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(s0 + i));
+        auto y = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(s1 + i));
+        auto result = _mm256_add_epi64(x, y);
+
+        // xorshift128+ step
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(s0 + i), y);
+        x = _mm256_xor_si256(x, _mm256_slli_epi64(x, 23));
+        x = _mm256_xor_si256(_mm256_xor_si256(x, y), _mm256_xor_si256(_mm256_srli_epi64(x, 18),
+                                                                       _mm256_srli_epi64(y, 5)));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(s1 + i), x);
+
+        // Top 52 bits as mantissa of double in [1, 2), shifted to [0, 1) and scaled to temperature range
+        auto bits = _mm256_or_si256(_mm256_srli_epi64(result, 12), v_exponent);
+        auto unit = _mm256_sub_pd(_mm256_castsi256_pd(bits), v_one);
+        _mm256_storeu_pd(temps + i, _mm256_add_pd(v_lb, _mm256_mul_pd(unit, v_range)));
+    }
+#endif
+
+    // Same kernel in scalar form, simple enough for the compiler to vectorize with SSE2
+    for (; i < end; i++) {
+        auto x = s0[i];
+        auto y = s1[i];
+        auto result = x + y;
+
+        s0[i] = y;
+        x ^= x << 23;
+        s1[i] = x ^ y ^ (x >> 18) ^ (y >> 5);
+
+        auto bits = (result >> 12) | one_exponent;
+        double unit;
+        std::memcpy(&unit, &bits, sizeof unit);
+        temps[i] = TempMonitor::TEMP_LB + (unit - 1.0) * range;
+    }
+}
+
+char *EHW::TempMonitorBatch::format_temp(double temp, char *dest)
+{
+    // Fixed point with six decimal places, matching std::to_string()
+    bool negative = temp < 0;
+    auto fixed = static_cast<uint64_t>((negative ? -temp : temp) * 1e6 + 0.5);
+    auto integral = fixed / 1000000;
+    auto fraction = static_cast<uint32_t>(fixed % 1000000);
+
+    if (negative) {
+        *dest++ = '-';
+    }
+    dest = std::to_chars(dest, dest + MAX_VALUE_LENGTH - 8, integral).ptr;
+    *dest++ = '.';
+    for (int d = 5; d >= 0; d--) {
+        dest[d] = static_cast<char>('0' + fraction % 10);
+        fraction /= 10;
+    }
+
+    return dest + 6;
+}
@@ -0,0 +1,65 @@
+/**
+ * Author: Matej Postolka <matej@postolka.net>
+ * License: BSD 3-clause
+ */
+
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+#include "DeviceBatch.h"
+
+namespace EHW {
+
+    /**
+     * Batch emulator of devices monitoring temperature in floating point values
+     *
+     * Every device has its own xorshift128+ generator, whose state is kept in two columns so that all
+     * generators are advanced by a single vectorized kernel.
+     */
+    class TempMonitorBatch final : public DeviceBatch {
+
+    private:
+        // Longest formatted temperature with six decimal places
+        static constexpr size_t MAX_VALUE_LENGTH = 16;
+
+        std::vector<double> m_current_temps;
+        // Generator state of every device
+        std::vector<uint64_t> m_rng_s0;
+        std::vector<uint64_t> m_rng_s1;
+
+    public:
+        TempMonitorBatch();
+
+        void reserve(size_t count, size_t identifier_bytes) override;
+
+        void add_device(const char *identifier, size_t length) override;
+
+        [[nodiscard]]
+        uint64_t get_poll_delay() const override;
+
+        void update_internal_state() override;
+
+        void serialize(size_t begin, size_t end, std::vector<uint8_t> &buffer) override;
+
+        void serialize(const uint32_t *indices, size_t count, std::vector<uint8_t> &buffer) override;
+
+    private:
+        /**
+         * Advance generators of range of devices and draw new temperatures
+         * @param begin Index of first device
+         * @param end Index past last device
+         */
+        void update_range(size_t begin, size_t end);
+
+        /**
+         * Format temperature with six decimal places
+         * @param temp Temperature
+         * @param dest Destination with room for MAX_VALUE_LENGTH characters
+         * @return Pointer past last written character
+         */
+        static char *format_temp(double temp, char *dest);
+
+    };
+}
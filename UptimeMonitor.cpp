@@ -5,8 +5,9 @@
 
 #include "UptimeMonitor.h"
 
-EHW::UptimeMonitor::UptimeMonitor(const char *identifier) : Device(identifier, Type::UPTIME_MONITOR),
-                                                            m_current_uptime(INITIAL_UPTIME)
+EHW::UptimeMonitor::UptimeMonitor(const char *identifier, size_t length) : Device(identifier, length,
+                                                                                    Type::UPTIME_MONITOR),
+                                                                             m_current_uptime(INITIAL_UPTIME)
 {
 
 }
@@ -18,12 +19,9 @@ uint64_t EHW::UptimeMonitor::get_poll_delay() const
 
 void EHW::UptimeMonitor::serialize()
 {
-    // Create initial serialized buffer
-    initialize_buffer();
-
-    // Append current uptime
+    // Encode frame with current uptime
     auto uptime_str = std::to_string(m_current_uptime);
-    add_str_to_buffer(uptime_str);
+    serialize_frame(uptime_str);
 }
 
 void EHW::UptimeMonitor::update_internal_state()
@@ -16,17 +16,18 @@ namespace EHW {
      */
     class UptimeMonitor final : public Device {
 
-    private:
+    public:
         static constexpr int INITIAL_UPTIME = 0;
         // Increment of uptime when update method is called
         static constexpr int UPTIME_STEP = 1000;
         // Statically set polling delay
         static constexpr int POLL_DELAY = 1000;
 
+    private:
         int m_current_uptime;
 
     public:
-        explicit UptimeMonitor(const char *identifier);
+        explicit UptimeMonitor(const char *identifier, size_t length);
 
         [[nodiscard]]
         uint64_t get_poll_delay() const override;
@@ -0,0 +1,52 @@
+/**
+ * Author: Matej Postolka <matej@postolka.net>
+ * License: BSD 3-clause
+ */
+
+#include <charconv>
+
+#include "UptimeMonitorBatch.h"
+#include "UptimeMonitor.h"
+
+EHW::UptimeMonitorBatch::UptimeMonitorBatch() : DeviceBatch(Device::Type::UPTIME_MONITOR)
+{
+}
+
+void EHW::UptimeMonitorBatch::reserve(size_t count, size_t identifier_bytes)
+{
+    DeviceBatch::reserve(count, identifier_bytes);
+    m_current_uptimes.reserve(m_current_uptimes.size() + count);
+}
+
+void EHW::UptimeMonitorBatch::add_device(const char *identifier, size_t length)
+{
+    DeviceBatch::add_device(identifier, length);
+    m_current_uptimes.push_back(UptimeMonitor::INITIAL_UPTIME);
+}
+
+uint64_t EHW::UptimeMonitorBatch::get_poll_delay() const
+{
+    return UptimeMonitor::POLL_DELAY;
+}
+
+void EHW::UptimeMonitorBatch::update_internal_state()
+{
+    // Trivially vectorized by the compiler
+    for (auto &uptime : m_current_uptimes) {
+        uptime += UptimeMonitor::UPTIME_STEP;
+    }
+}
+
+void EHW::UptimeMonitorBatch::serialize(size_t begin, size_t end, std::vector<uint8_t> &buffer)
+{
+    serialize_frames<MAX_VALUE_LENGTH>(begin, end, buffer, [this](size_t i, char *dest) {
+        return std::to_chars(dest, dest + MAX_VALUE_LENGTH, m_current_uptimes[i]).ptr;
+    });
+}
+
+void EHW::UptimeMonitorBatch::serialize(const uint32_t *indices, size_t count, std::vector<uint8_t> &buffer)
+{
+    serialize_frames<MAX_VALUE_LENGTH>(indices, indices + count, buffer, [this](size_t i, char *dest) {
+        return std::to_chars(dest, dest + MAX_VALUE_LENGTH, m_current_uptimes[i]).ptr;
+    });
+}
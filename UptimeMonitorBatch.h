@@ -0,0 +1,43 @@
+/**
+ * Author: Matej Postolka <matej@postolka.net>
+ * License: BSD 3-clause
+ */
+
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+#include "DeviceBatch.h"
+
+namespace EHW {
+
+    /**
+     * Batch emulator of devices tracking uptime in milliseconds
+     */
+    class UptimeMonitorBatch final : public DeviceBatch {
+
+    private:
+        // Longest formatted 64-bit uptime
+        static constexpr size_t MAX_VALUE_LENGTH = 20;
+
+        std::vector<int64_t> m_current_uptimes;
+
+    public:
+        UptimeMonitorBatch();
+
+        void reserve(size_t count, size_t identifier_bytes) override;
+
+        void add_device(const char *identifier, size_t length) override;
+
+        [[nodiscard]]
+        uint64_t get_poll_delay() const override;
+
+        void update_internal_state() override;
+
+        void serialize(size_t begin, size_t end, std::vector<uint8_t> &buffer) override;
+
+        void serialize(const uint32_t *indices, size_t count, std::vector<uint8_t> &buffer) override;
+
+    };
+}
@@ -4,16 +4,26 @@
  */
 
 #include <iostream>
-#include <memory>
 #include <cstring>
-#include <stdexcept>
+#include <string>
+#include <vector>
+#include <sstream>
+
+#include <unistd.h>
 
 #include "Device.h"
 #include "Client.h"
-#include "TempMonitor.h"
-#include "UptimeMonitor.h"
+#include "FleetFile.h"
 
-const char *usage = "./client SERVER_IP SERVER_PORT [DEVICE-TYPE DEVICE-ID] ... [DEVICE-TYPE DEVICE-ID]\n";
+const char *usage = "./client [-S] [-b] [-t THREADS] [-c CONNECTIONS] [-f FLEET_FILE] [-s SERVER]... [-v VNODES] "
+                    "SERVER_IP SERVER_PORT [DEVICE-TYPE DEVICE-ID] ... [DEVICE-TYPE DEVICE-ID]\n"
+                    "\t-S              attach per-device sequence numbers to sent data\n"
+                    "\t-b              emulate devices with batch engine\n"
+                    "\t-f FLEET_FILE   attach devices listed in FLEET_FILE, one DEVICE-TYPE DEVICE-ID per line\n"
+                    "\t-t THREADS      number of worker threads emulating devices (default 1)\n"
+                    "\t-c CONNECTIONS  number of connections per worker thread and server (default 1)\n"
+                    "\t-s SERVER       spread devices over another server, SERVER is SERVER_IP:SERVER_PORT\n"
+                    "\t-v VNODES       points of every server on consistent-hash ring (default 128)\n";
 
 void print_help(std::ostream &s)
 {
@@ -24,44 +34,118 @@ void print_help(std::ostream &s)
     }
 }
 
+/**
+ * Parse server address of form SERVER_IP:SERVER_PORT
+ * @param spec Address string
+ * @param address Destination
+ * @return true if address is valid
+ */
+bool parse_server(const char *spec, EHW::ServerAddress &address)
+{
+    std::istringstream ss(spec);
+    std::string field;
+    if (!std::getline(ss, address.ip, ':') || !std::getline(ss, field, ':')) {
+        return false;
+    }
+    auto port = std::stoul(field);
+    if (port == 0 || port > UINT16_MAX) {
+        return false;
+    }
+    address.port = static_cast<uint16_t>(port);
+
+    return ss.eof();
+}
+
 int main(int argc, char **argv)
 {
-    if ((argc < 3) || (argc % 2 == 0)) {
+    bool sequence_numbers = false;
+    bool batch = false;
+    unsigned threads = 1;
+    unsigned connections = 1;
+    const char *fleet_path = nullptr;
+    std::vector<EHW::ServerAddress> servers;
+    uint32_t virtual_nodes = EHW::HashRing::DEFAULT_VIRTUAL_NODES;
+
+    int opt;
+    while ((opt = ::getopt(argc, argv, "Sbt:c:f:s:v:")) != -1) {
+        switch (opt) {
+            case 'S':
+                sequence_numbers = true;
+                break;
+            case 'b':
+                batch = true;
+                break;
+            case 't':
+                threads = std::stoul(optarg);
+                break;
+            case 'c':
+                connections = std::stoul(optarg);
+                break;
+            case 'f':
+                fleet_path = optarg;
+                break;
+            case 's':
+                if (!parse_server(optarg, servers.emplace_back())) {
+                    print_help(std::cerr);
+                    return 1;
+                }
+                break;
+            case 'v':
+                virtual_nodes = std::stoul(optarg);
+                break;
+            default:
+                print_help(std::cerr);
+                return 1;
+        }
+    }
+
+    argc -= optind - 1;
+    argv += optind;
+
+    if ((argc < 3) || (argc % 2 == 0) || threads == 0 || connections == 0 || virtual_nodes == 0) {
         print_help(std::cerr);
         return 1;
     }
-    argv++;
 
     // Create base client
     auto server_ip = *argv++;
     auto server_port = std::stoi(*argv++);
 
     auto client = EHW::Client(server_ip, server_port);
+    client.set_threads(threads);
+    client.set_connections_per_thread(connections);
+    for (const auto &server : servers) {
+        client.add_server(server.ip, server.port);
+    }
+    client.set_virtual_nodes(virtual_nodes);
+    if (sequence_numbers) {
+        client.enable_sequence_numbers();
+    }
     EHW::Client::signal_setup();
 
+    // Attach devices of fleet file
+    if (fleet_path) {
+        EHW::FleetFile fleet(fleet_path);
+        client.attach_fleet(fleet, batch);
+    }
+
     // Attach requested devices
     for (auto i = 3; i < argc; i += 2) {
         auto device_type = *argv++;
         auto device_id = *argv++;
 
-        std::unique_ptr<EHW::Device> device;
         auto it = EHW::Device::TYPE_STRINGS.find(device_type);
         if (it == EHW::Device::TYPE_STRINGS.end()) {
             print_help(std::cerr);
             return 1;
         }
 
-        if (it->second == EHW::Device::Type::TEMP_MONITOR) {
-            device = std::make_unique<EHW::TempMonitor>(EHW::TempMonitor(device_id));
-        }
-        else if (it->second == EHW::Device::Type::UPTIME_MONITOR) {
-            device = std::make_unique<EHW::UptimeMonitor>(EHW::UptimeMonitor(device_id));
+        if (batch) {
+            client.attach_batched_device(it->second, device_id, std::strlen(device_id));
         }
         else {
-            throw std::runtime_error("Unimplemented device type");
+            client.attach_device(it->second, device_id, std::strlen(device_id));
         }
-
-        client.attach_device(std::move(device));
     }
 
     // Launch client
@@ -0,0 +1,61 @@
+/**
+ * Author: Matej Postolka <matej@postolka.net>
+ * License: BSD 3-clause
+ */
+
+#include <iostream>
+#include <cstring>
+#include <stdexcept>
+
+#include <unistd.h>
+
+#include "Replay.h"
+
+const char *usage = "./replay [-s SPEED] [-c COPIES] [-t THREADS] SERVER_IP SERVER_PORT CAPTURE_FILE\n"
+                    "\t-s SPEED    replay speed multiplier or 'max' (default 1)\n"
+                    "\t-c COPIES   number of concurrent copies of the capture (default 1)\n"
+                    "\t-t THREADS  number of worker threads (default 1)\n";
+
+int main(int argc, char **argv)
+{
+    double speed = 1.0;
+    unsigned copies = 1;
+    unsigned threads = 1;
+
+    int opt;
+    while ((opt = ::getopt(argc, argv, "s:c:t:")) != -1) {
+        switch (opt) {
+            case 's':
+                speed = std::strcmp(optarg, "max") == 0 ? 0.0 : std::stod(optarg);
+                break;
+            case 'c':
+                copies = std::stoul(optarg);
+                break;
+            case 't':
+                threads = std::stoul(optarg);
+                break;
+            default:
+                std::cerr << usage;
+                return 1;
+        }
+    }
+
+    if (argc - optind != 3 || speed < 0 || copies == 0 || threads == 0) {
+        std::cerr << usage;
+        return 1;
+    }
+
+    auto server_ip = argv[optind];
+    auto server_port = std::stoi(argv[optind + 1]);
+    auto capture_path = argv[optind + 2];
+
+    auto replayer = EHW::Replayer(server_ip, server_port, capture_path);
+    replayer.set_speed(speed);
+    replayer.set_copies(copies);
+    replayer.set_threads(threads);
+    EHW::Replayer::signal_setup();
+
+    replayer.run();
+
+    return 0;
+}
@@ -4,21 +4,274 @@
  */
 
 #include <iostream>
+#include <cstring>
+#include <sstream>
+#include <string>
+#include <iterator>
+
+#include <unistd.h>
 
 #include "Server.h"
 
-const char *usage = "./server PORT\n";
+const char *usage = "./server [-r] [-p PROCESSORS] [-m MEMORY [-H]] [-k SKETCH [-x]] [-w CAPTURE_FILE] [-a EXPORT] [-A RULES_FILE [-o ALERT_FILE]] [-u UPSTREAM [-R]] [-s SUB_PORT [-q DEPTH] [-D oldest|newest]] PORT\n"
+                    "\t-r               resynchronize corrupted streams instead of dropping connection\n"
+                    "\t-p PROCESSORS    process readings in pipeline with PROCESSORS processing threads\n"
+                    "\t-m MEMORY        limit memory held by connections, MEMORY is\n"
+                    "\t                 BUDGET_MB[:BUFFER_KB[:FRAME_KB]] (default 1024:16:16)\n"
+                    "\t-H               back receive buffers by huge pages\n"
+                    "\t-k SKETCH        collect bounded-memory device statistics, SKETCH is\n"
+                    "\t                 WIDTH[:DEPTH[:TOP-K[:PRECISION[:WINDOW]]]] (default 65536:4:16:14:60)\n"
+                    "\t-x               do not keep exact per-device counters\n"
+                    "\t-w CAPTURE_FILE  record inbound traffic into capture file\n"
+                    "\t-a EXPORT        export readings into Arrow IPC stream files, EXPORT is\n"
+                    "\t                 DIR[:MAX_MB[:MAX_SECONDS]] (default DIR:256:3600)\n"
+                    "\t-A RULES_FILE    raise alerts according to rules in RULES_FILE\n"
+                    "\t-o ALERT_FILE    append alerts to ALERT_FILE instead of standard error output\n"
+                    "\t-u UPSTREAM      forward readings to upstream server, UPSTREAM is\n"
+                    "\t                 HOST:PORT[:CONNECTIONS[:WINDOW]] (default HOST:PORT:1:1)\n"
+                    "\t-R               forward raw frames instead of per-device summaries of every window\n"
+                    "\t-s SUB_PORT      publish readings to subscribers connecting on SUB_PORT\n"
+                    "\t-q DEPTH         readings queued per subscriber (default 4096)\n"
+                    "\t-D POLICY        drop oldest or newest readings of slow subscribers (default oldest)\n";
+
+/**
+ * Parse sketch configuration of form WIDTH[:DEPTH[:TOP-K[:PRECISION[:WINDOW]]]]
+ * @param spec Configuration string
+ * @param config Destination, omitted fields keep their values
+ * @return true if configuration is valid
+ */
+bool parse_sketch_config(const char *spec, EHW::DeviceSketch::Config &config)
+{
+    uint32_t *fields[] = {&config.width, &config.depth, &config.top_k, &config.precision, &config.window};
+
+    std::istringstream ss(spec);
+    std::string field;
+    for (auto dest : fields) {
+        if (!std::getline(ss, field, ':')) {
+            break;
+        }
+        *dest = std::stoul(field);
+    }
+
+    return ss.eof() && config.width >= 1 && config.width <= (1u << 30) && config.depth >= 1 && config.depth <= 16 &&
+           config.precision >= EHW::HyperLogLog::MIN_PRECISION && config.precision <= EHW::HyperLogLog::MAX_PRECISION &&
+           config.window >= 1;
+}
+
+/**
+ * Parse Arrow export configuration of form DIR[:MAX_MB[:MAX_SECONDS]]
+ * @param spec Configuration string
+ * @param config Destination, omitted fields keep their values
+ * @return true if configuration is valid
+ */
+bool parse_arrow_config(const char *spec, EHW::ArrowWriter::Config &config)
+{
+    std::istringstream ss(spec);
+    std::string field;
+    if (!std::getline(ss, config.directory, ':') || config.directory.empty()) {
+        return false;
+    }
+    if (std::getline(ss, field, ':')) {
+        config.max_file_size = std::stoull(field) * 1024 * 1024;
+    }
+    if (std::getline(ss, field, ':')) {
+        config.max_file_age = std::stoul(field);
+    }
+
+    return ss.eof() && config.max_file_size >= 1 && config.max_file_age >= 1;
+}
+
+/**
+ * Parse relay configuration of form HOST:PORT[:CONNECTIONS[:WINDOW]]
+ * @param spec Configuration string
+ * @param config Destination, omitted fields keep their values
+ * @return true if configuration is valid
+ */
+bool parse_relay_config(const char *spec, EHW::Relay::Config &config)
+{
+    std::istringstream ss(spec);
+    std::string field;
+    if (!std::getline(ss, config.host, ':') || !std::getline(ss, field, ':')) {
+        return false;
+    }
+    auto port = std::stoul(field);
+    if (port == 0 || port > UINT16_MAX) {
+        return false;
+    }
+    config.port = static_cast<uint16_t>(port);
+    if (std::getline(ss, field, ':')) {
+        config.connections = std::stoul(field);
+    }
+    if (std::getline(ss, field, ':')) {
+        config.window = std::stoul(field);
+    }
+
+    return ss.eof() && config.connections >= 1 && config.window >= 1;
+}
+
+/**
+ * Parse memory limits of form BUDGET_MB[:BUFFER_KB[:FRAME_KB]]
+ * @param spec Configuration string
+ * @param limits Destination, omitted fields keep their values
+ * @return true if limits are valid
+ */
+bool parse_memory_limits(const char *spec, EHW::Server::MemoryLimits &limits)
+{
+    size_t *fields[] = {&limits.budget, &limits.buffer_size, &limits.max_frame_size};
+    size_t units[] = {1024 * 1024, 1024, 1024};
+
+    std::istringstream ss(spec);
+    std::string field;
+    for (size_t i = 0; i < std::size(fields); i++) {
+        if (!std::getline(ss, field, ':')) {
+            break;
+        }
+        *fields[i] = std::stoull(field) * units[i];
+    }
+
+    return ss.eof() && limits.budget >= EHW::Server::get_min_memory_budget() &&
+           limits.buffer_size <= EHW::BufferPool::REGION_SIZE &&
+           limits.max_frame_size >= EHW::Server::MIN_MAX_FRAME_SIZE && limits.max_frame_size <= limits.buffer_size;
+}
 
 int main(int argc, char **argv)
 {
-    if (argc != 2) {
+    bool resync = false;
+    size_t processors = 0;
+    EHW::Server::MemoryLimits memory_limits;
+    bool sketch = false;
+    bool exact_counters = true;
+    EHW::DeviceSketch::Config sketch_config;
+    const char *capture_path = nullptr;
+    bool arrow = false;
+    EHW::ArrowWriter::Config arrow_config;
+    const char *rules_path = nullptr;
+    const char *alert_path = nullptr;
+    bool relay = false;
+    EHW::Relay::Config relay_config;
+    int sub_port = 0;
+    size_t queue_depth = EHW::Publisher::DEFAULT_QUEUE_DEPTH;
+    auto drop_policy = EHW::Publisher::DropPolicy::DROP_OLDEST;
+
+    int opt;
+    while ((opt = ::getopt(argc, argv, "rp:m:Hk:xw:a:A:o:u:Rs:q:D:")) != -1) {
+        switch (opt) {
+            case 'r':
+                resync = true;
+                break;
+            case 'p':
+                processors = std::stoul(optarg);
+                if (processors == 0) {
+                    std::cerr << usage;
+                    return 1;
+                }
+                break;
+            case 'm':
+                if (!parse_memory_limits(optarg, memory_limits)) {
+                    std::cerr << usage;
+                    return 1;
+                }
+                break;
+            case 'H':
+                memory_limits.huge_pages = true;
+                break;
+            case 'k':
+                sketch = true;
+                if (!parse_sketch_config(optarg, sketch_config)) {
+                    std::cerr << usage;
+                    return 1;
+                }
+                break;
+            case 'x':
+                exact_counters = false;
+                break;
+            case 'w':
+                capture_path = optarg;
+                break;
+            case 'a':
+                arrow = true;
+                if (!parse_arrow_config(optarg, arrow_config)) {
+                    std::cerr << usage;
+                    return 1;
+                }
+                break;
+            case 'A':
+                rules_path = optarg;
+                break;
+            case 'o':
+                alert_path = optarg;
+                break;
+            case 'u':
+                relay = true;
+                if (!parse_relay_config(optarg, relay_config)) {
+                    std::cerr << usage;
+                    return 1;
+                }
+                break;
+            case 'R':
+                relay_config.raw = true;
+                break;
+            case 's':
+                sub_port = std::stoi(optarg);
+                break;
+            case 'q':
+                queue_depth = std::stoul(optarg);
+                break;
+            case 'D':
+                if (std::strcmp(optarg, "oldest") == 0) {
+                    drop_policy = EHW::Publisher::DropPolicy::DROP_OLDEST;
+                }
+                else if (std::strcmp(optarg, "newest") == 0) {
+                    drop_policy = EHW::Publisher::DropPolicy::DROP_NEWEST;
+                }
+                else {
+                    std::cerr << usage;
+                    return 1;
+                }
+                break;
+            default:
+                std::cerr << usage;
+                return 1;
+        }
+    }
+
+    if (argc - optind != 1 || queue_depth == 0 || (!exact_counters && !sketch) || (alert_path && !rules_path) ||
+        (relay_config.raw && !relay)) {
         std::cerr << usage;
         return 1;
     }
 
-    auto port = std::stoi(argv[1]);
+    auto port = std::stoi(argv[optind]);
 
     auto server = EHW::Server(port);
+    server.set_memory_limits(memory_limits);
+    if (resync) {
+        server.enable_resync();
+    }
+    if (processors > 0) {
+        server.enable_pipeline(processors);
+    }
+    if (sketch) {
+        server.enable_sketch(sketch_config);
+    }
+    if (!exact_counters) {
+        server.disable_exact_counters();
+    }
+    if (capture_path) {
+        server.enable_capture(capture_path);
+    }
+    if (arrow) {
+        server.enable_arrow(arrow_config);
+    }
+    if (rules_path) {
+        server.enable_alerts(rules_path, alert_path);
+    }
+    if (relay) {
+        server.enable_relay(relay_config);
+    }
+    if (sub_port != 0) {
+        server.enable_publisher(sub_port, queue_depth, drop_policy);
+    }
     EHW::Server::signal_setup();
 
     server.run();